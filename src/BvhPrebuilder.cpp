@@ -0,0 +1,151 @@
+#include "BvhPrebuilder.hpp"
+#include "TaskPool.hpp"
+#include <algorithm>
+#include <deque>
+#include <opencascade/Select3D_SensitiveSet.hxx>
+#include <opencascade/SelectMgr_Selection.hxx>
+
+struct BvhPrebuilder::State {
+  std::mutex mutex;
+  std::function<void()> onBuilt;
+  std::vector<Handle(AIS_InteractiveObject)> built;
+  // Bumped by clear, so objects of the previous scene are dropped.
+  size_t generation = 0;
+  bool isClosed = false;
+};
+
+namespace {
+struct Entry {
+  std::shared_ptr<BvhPrebuilder::State> owner;
+  size_t generation = 0;
+  Handle(AIS_InteractiveObject) object;
+  // Collected on the main thread, so the jobs never walk the selections of
+  // an object the main thread may be removing.
+  std::vector<Handle(Select3D_SensitiveSet)> sets;
+};
+
+// One queue for the objects of all viewers.
+struct SharedQueue {
+  std::mutex mutex;
+  std::deque<Entry> entries;
+  int nbJobs = 0;
+};
+
+SharedQueue &sharedQueue() {
+  static SharedQueue queue;
+  return queue;
+}
+
+// Takes the queued entries of `owner` out of the shared queue. Called on the
+// main thread, so the objects are released there.
+std::vector<Entry> takeEntriesOf(BvhPrebuilder::State const *owner) {
+  SharedQueue &queue = sharedQueue();
+  std::vector<Entry> taken;
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  auto const isOwned = [owner](Entry const &entry) {
+    return entry.owner.get() == owner;
+  };
+  for (auto &entry : queue.entries) {
+    if (isOwned(entry)) { taken.push_back(std::move(entry)); }
+  }
+  queue.entries.erase(
+      std::remove_if(queue.entries.begin(), queue.entries.end(),
+                     [](Entry const &entry) { return !entry.owner; }),
+      queue.entries.end());
+  return taken;
+}
+
+void runJob() {
+  SharedQueue &queue = sharedQueue();
+  while (true) {
+    Entry entry;
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.entries.empty()) {
+        queue.nbJobs -= 1;
+        return;
+      }
+      entry = std::move(queue.entries.front());
+      queue.entries.pop_front();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(entry.owner->mutex);
+      if (entry.owner->isClosed ||
+          entry.owner->generation != entry.generation) {
+        continue;
+      }
+    }
+    // Builds with the default builder, which is single threaded.
+    for (auto const &set : entry.sets) {
+      set->BVH();
+    }
+
+    // The callback runs under the owner's lock, so it never runs after the
+    // destructor of the prebuilder returned.
+    std::lock_guard<std::mutex> lock(entry.owner->mutex);
+    if (entry.owner->isClosed ||
+        entry.owner->generation != entry.generation) {
+      continue;
+    }
+    entry.owner->built.push_back(std::move(entry.object));
+    if (entry.owner->onBuilt) { entry.owner->onBuilt(); }
+  }
+}
+} // namespace
+
+BvhPrebuilder::BvhPrebuilder(std::function<void()> onBuilt)
+    : state(std::make_shared<State>()) {
+  state->onBuilt = onBuilt;
+}
+
+BvhPrebuilder::~BvhPrebuilder() {
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->isClosed = true;
+    state->onBuilt = nullptr;
+    state->built.clear();
+  }
+  takeEntriesOf(state.get());
+}
+
+void BvhPrebuilder::push(Handle(AIS_InteractiveObject) const &object) {
+  Entry entry;
+  entry.owner = state;
+  entry.object = object;
+  for (auto const &selection : object->Selections()) {
+    for (auto const &sensitive : selection->Entities()) {
+      Handle(Select3D_SensitiveSet) set =
+          Handle(Select3D_SensitiveSet)::DownCast(sensitive->BaseSensitive());
+      if (!set.IsNull()) { entry.sets.push_back(set); }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    entry.generation = state->generation;
+  }
+
+  SharedQueue &queue = sharedQueue();
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  queue.entries.push_back(std::move(entry));
+  if (queue.nbJobs < PICKING_THREADS) {
+    queue.nbJobs += 1;
+    TaskPool::instance().submit(runJob);
+  }
+}
+
+void BvhPrebuilder::clear() {
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->generation += 1;
+    state->built.clear();
+  }
+  takeEntriesOf(state.get());
+}
+
+std::vector<Handle(AIS_InteractiveObject)> BvhPrebuilder::takeBuilt() {
+  std::vector<Handle(AIS_InteractiveObject)> taken;
+  std::lock_guard<std::mutex> lock(state->mutex);
+  std::swap(taken, state->built);
+  return taken;
+}
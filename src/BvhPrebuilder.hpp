@@ -0,0 +1,47 @@
+#ifndef BVHPREBUILDER_HPP
+#define BVHPREBUILDER_HPP
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <opencascade/AIS_InteractiveObject.hxx>
+#include <vector>
+
+#ifndef PICKING_THREADS
+#define PICKING_THREADS 2
+#endif
+
+/**
+ * Builds the picking BVHs of computed selections on the TaskPool, ahead of
+ * their activation on the main thread.
+ *
+ * All viewers share one queue, drained by at most PICKING_THREADS pool jobs,
+ * so the number of threads does not grow with the number of viewers. Only
+ * the sensitive sets of an object are touched, and only while the object is
+ * not activated: the main thread neither picks nor rebuilds them until the
+ * object comes back from takeBuilt. Every finished object calls `onBuilt`
+ * from the pool thread.
+ *
+ * The destructor does not wait for queued objects. It detaches the viewer,
+ * and jobs drop whatever they build for it afterwards.
+ */
+class BvhPrebuilder {
+public:
+  BvhPrebuilder(std::function<void()> onBuilt);
+  ~BvhPrebuilder();
+
+  // Queues the BVHs of every selection `object` has computed.
+  void push(Handle(AIS_InteractiveObject) const &object);
+
+  // Drops the objects of this viewer that were not built yet, and those
+  // built but not taken.
+  void clear();
+
+  // Objects whose BVHs were built since the last call.
+  std::vector<Handle(AIS_InteractiveObject)> takeBuilt();
+
+  struct State;
+
+private:
+  std::shared_ptr<State> state;
+};
+#endif // BVHPREBUILDER_HPP
@@ -0,0 +1,193 @@
+#include "CompactVertexFormat.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <opencascade/Graphic3d_ShaderAttribute.hxx>
+#include <opencascade/Graphic3d_ShaderObject.hxx>
+
+namespace {
+
+size_t const COMPACT_VERTEX_STRIDE = 8;
+
+uint16_t quantize(double value, double origin, double scale) {
+  double const unit = std::clamp((value - origin) / scale, 0.0, 1.0);
+  return static_cast<uint16_t>(std::lround(unit * 65535.0));
+}
+
+uint8_t toUnorm8(double value) {
+  return static_cast<uint8_t>(
+      std::lround(std::clamp(value * 0.5 + 0.5, 0.0, 1.0) * 255.0));
+}
+
+double signNotZero(double value) { return value < 0.0 ? -1.0 : 1.0; }
+
+// Octahedral normal encoding (Meyer et al., "On Floating-Point Normal
+// Vectors"), 8 bits per component.
+void encodeOctahedral(gp_Dir const &normal, uint8_t *out) {
+  double const l1 =
+      std::abs(normal.X()) + std::abs(normal.Y()) + std::abs(normal.Z());
+  double u = normal.X() / l1;
+  double v = normal.Y() / l1;
+  if (normal.Z() < 0.0) {
+    double const foldedU = (1.0 - std::abs(v)) * signNotZero(u);
+    double const foldedV = (1.0 - std::abs(u)) * signNotZero(v);
+    u = foldedU;
+    v = foldedV;
+  }
+  out[0] = toUnorm8(u);
+  out[1] = toUnorm8(v);
+}
+
+// clang-format off
+char const *COMPACT_VERTEX_SHADER =
+    "THE_ATTRIBUTE vec4 occPackedVertex;\n"
+    "THE_SHADER_OUT vec3 vNormal;\n"
+    "THE_SHADER_OUT vec4 vPositionWorld;\n"
+    "float unpack16(float hi, float lo) {\n"
+    "  return (floor(hi * 255.0 + 0.5) * 256.0 + floor(lo * 255.0 + 0.5)) / 65535.0;\n"
+    "}\n"
+    "vec3 decodeOctahedral(vec2 e) {\n"
+    "  e = e * 2.0 - 1.0;\n"
+    "  vec3 n = vec3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));\n"
+    "  if (n.z < 0.0) {\n"
+    "    vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+    "    n.xy = (1.0 - abs(n.yx)) * signs;\n"
+    "  }\n"
+    "  return normalize(n);\n"
+    "}\n"
+    "void main() {\n"
+    "  vec4 aPosition = vec4(unpack16(occVertex.x, occVertex.y),\n"
+    "                        unpack16(occVertex.z, occVertex.w),\n"
+    "                        unpack16(occPackedVertex.x, occPackedVertex.y),\n"
+    "                        1.0);\n"
+    "  vec3 aNormal = decodeOctahedral(occPackedVertex.zw);\n"
+    "  mat4 aModelView = occWorldViewMatrix * occModelWorldMatrix;\n"
+    "  vNormal = normalize((aModelView * vec4(aNormal, 0.0)).xyz);\n"
+    "  vPositionWorld = occModelWorldMatrix * aPosition;\n"
+    "  gl_Position = occProjectionMatrix * aModelView * aPosition;\n"
+    "}\n";
+
+// Two-sided headlight, matching the default viewer lights closely enough for
+// large assemblies. OCCT leaves clipping to custom programs, so section
+// planes are applied here as in its generated ones; the viewer never chains
+// planes, so each one clips on its own.
+char const *COMPACT_FRAGMENT_SHADER =
+    "THE_SHADER_IN vec3 vNormal;\n"
+    "THE_SHADER_IN vec4 vPositionWorld;\n"
+    "void main() {\n"
+    "#if defined(THE_MAX_CLIP_PLANES) && (THE_MAX_CLIP_PLANES > 0)\n"
+    "  vec3 aPosition = vPositionWorld.xyz / vPositionWorld.w;\n"
+    "  for (int aPlaneIter = 0; aPlaneIter < THE_MAX_CLIP_PLANES; ++aPlaneIter) {\n"
+    "    if (aPlaneIter >= occClipPlaneCount) { break; }\n"
+    "    vec4 anEquation = occClipPlaneEquations[aPlaneIter];\n"
+    "    if (dot(anEquation.xyz, aPosition) + anEquation.w < 0.0) { discard; }\n"
+    "  }\n"
+    "#endif\n"
+    "  float aDiffuse = abs(normalize(vNormal).z);\n"
+    "  occSetFragColor(vec4(occColor.rgb * (0.3 + 0.7 * aDiffuse), occColor.a));\n"
+    "}\n";
+// clang-format on
+
+} // namespace
+
+gp_Trsf compactDequantization(Bnd_Box const &bounds) {
+  gp_Trsf dequantization;
+  if (bounds.IsVoid()) { return dequantization; }
+
+  // A cube rather than the box itself, because gp_Trsf only scales
+  // uniformly.
+  gp_XYZ const boundsMin = bounds.CornerMin().XYZ();
+  gp_XYZ const size = bounds.CornerMax().XYZ() - boundsMin;
+  double scale = std::max({size.X(), size.Y(), size.Z()});
+  if (scale <= 0.0) { scale = 1.0; }
+
+  dequantization.SetScale(gp::Origin(), scale);
+  gp_Trsf translation;
+  translation.SetTranslation(gp_Vec(boundsMin));
+  return translation * dequantization;
+}
+
+CompactMesh buildCompactMesh(Handle(Poly_Triangulation) const &triangulation,
+                             gp_Trsf const &dequantization) {
+  CompactMesh compact;
+  if (triangulation.IsNull() || !triangulation->HasNormals()) {
+    return compact;
+  }
+
+  gp_XYZ const origin = dequantization.TranslationPart();
+  double const scale = dequantization.ScaleFactor();
+
+  Standard_Integer const nbNodes = triangulation->NbNodes();
+  Graphic3d_Attribute const attributes[] = {
+      {Graphic3d_TOA_POS, Graphic3d_TOD_VEC4UB},
+      {Graphic3d_TOA_CUSTOM, Graphic3d_TOD_VEC4UB}};
+  compact.vertices = new Graphic3d_Buffer(Graphic3d_Buffer::DefaultAllocator());
+  if (!compact.vertices->Init(nbNodes, attributes, 2)) {
+    compact.vertices.Nullify();
+    return compact;
+  }
+
+  uint16_t qMin[3] = {65535, 65535, 65535};
+  uint16_t qMax[3] = {0, 0, 0};
+  Standard_Byte *data = compact.vertices->ChangeData();
+  for (Standard_Integer i = 1; i <= nbNodes; ++i) {
+    gp_XYZ const p = triangulation->Node(i).XYZ();
+    uint8_t *vertex = data + (i - 1) * COMPACT_VERTEX_STRIDE;
+    uint16_t const q[3] = {quantize(p.X(), origin.X(), scale),
+                           quantize(p.Y(), origin.Y(), scale),
+                           quantize(p.Z(), origin.Z(), scale)};
+    for (int k = 0; k < 3; ++k) {
+      vertex[k * 2] = static_cast<uint8_t>(q[k] >> 8);
+      vertex[k * 2 + 1] = static_cast<uint8_t>(q[k] & 0xFF);
+      qMin[k] = std::min(qMin[k], q[k]);
+      qMax[k] = std::max(qMax[k], q[k]);
+    }
+    encodeOctahedral(triangulation->Normal(i), vertex + 6);
+  }
+
+  Standard_Integer const nbTriangles = triangulation->NbTriangles();
+  compact.indices =
+      new Graphic3d_IndexBuffer(Graphic3d_Buffer::DefaultAllocator());
+  bool const isInitialized =
+      nbNodes <= 65535
+          ? compact.indices->Init<unsigned short>(nbTriangles * 3)
+          : compact.indices->Init<unsigned int>(nbTriangles * 3);
+  if (!isInitialized) {
+    compact.vertices.Nullify();
+    compact.indices.Nullify();
+    return compact;
+  }
+  for (Standard_Integer i = 1; i <= nbTriangles; ++i) {
+    Standard_Integer n[3];
+    triangulation->Triangle(i).Get(n[0], n[1], n[2]);
+    for (int k = 0; k < 3; ++k) {
+      compact.indices->SetIndex((i - 1) * 3 + k, n[k] - 1);
+    }
+  }
+
+  compact.boundsMin = Graphic3d_Vec3(qMin[0] / 65535.0f, qMin[1] / 65535.0f,
+                                     qMin[2] / 65535.0f);
+  compact.boundsMax = Graphic3d_Vec3(qMax[0] / 65535.0f, qMax[1] / 65535.0f,
+                                     qMax[2] / 65535.0f);
+  return compact;
+}
+
+Handle(Graphic3d_ShaderProgram) compactVertexShaderProgram() {
+  static Handle(Graphic3d_ShaderProgram) program;
+  if (!program.IsNull()) { return program; }
+
+  program = new Graphic3d_ShaderProgram();
+  program->AttachShader(Graphic3d_ShaderObject::CreateFromSource(
+      Graphic3d_TOS_VERTEX, COMPACT_VERTEX_SHADER));
+  program->AttachShader(Graphic3d_ShaderObject::CreateFromSource(
+      Graphic3d_TOS_FRAGMENT, COMPACT_FRAGMENT_SHADER));
+
+  Graphic3d_ShaderAttributeList attributes;
+  attributes.Append(
+      new Graphic3d_ShaderAttribute("occPackedVertex", Graphic3d_TOA_CUSTOM));
+  program->SetVertexAttributes(attributes);
+  // Declares occClipPlaneEquations and occClipPlaneCount for the shaders.
+  program->SetNbClipPlanesMax(
+      Graphic3d_ShaderProgram::THE_MAX_CLIP_PLANES_DEFAULT);
+  return program;
+}
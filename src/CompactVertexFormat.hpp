@@ -0,0 +1,54 @@
+#ifndef COMPACTVERTEXFORMAT_HPP
+#define COMPACTVERTEXFORMAT_HPP
+#include <opencascade/Bnd_Box.hxx>
+#include <opencascade/Graphic3d_Buffer.hxx>
+#include <opencascade/Graphic3d_IndexBuffer.hxx>
+#include <opencascade/Graphic3d_ShaderProgram.hxx>
+#include <opencascade/Poly_Triangulation.hxx>
+#include <opencascade/gp_Trsf.hxx>
+
+/**
+ * Shaded triangles packed at 8 bytes per vertex instead of the 24 bytes of a
+ * float position and normal.
+ *
+ * Positions are quantized to 16 bits per axis inside the part's bounding cube
+ * and normals are octahedral-encoded in 8 bits per component:
+ *
+ *   occVertex       = (x hi, x lo, y hi, y lo)
+ *   occPackedVertex = (z hi, z lo, normal u, normal v)
+ *
+ * Decoded positions lie in the unit cube. The dequantization maps them back
+ * to world space; it has to end up in occModelWorldMatrix, so it belongs in
+ * the local transformation of the object drawing them, see
+ * StaircaseCompactMesh.
+ */
+struct CompactMesh {
+  Handle(Graphic3d_Buffer) vertices;
+  Handle(Graphic3d_IndexBuffer) indices;
+  // Decoded bounds, inside the unit cube.
+  Graphic3d_Vec3 boundsMin;
+  Graphic3d_Vec3 boundsMax;
+};
+
+/**
+ * Maps the unit cube onto the bounding cube of `bounds`. Meshes sharing it
+ * can be drawn with the same transformation.
+ */
+gp_Trsf compactDequantization(Bnd_Box const &bounds);
+
+/**
+ * Packs a triangulation with normals into the compact vertex format, quantized
+ * inside the cube `dequantization` maps the unit cube to. Nodes outside of it
+ * are clamped onto it.
+ */
+CompactMesh buildCompactMesh(Handle(Poly_Triangulation) const &triangulation,
+                             gp_Trsf const &dequantization);
+
+/**
+ * Shader program decoding the compact vertex format. A single instance is
+ * shared by every presentation so that only one GL program gets linked.
+ * Shading uses a two-sided headlight on the object color, not the view's
+ * lights or the material.
+ */
+Handle(Graphic3d_ShaderProgram) compactVertexShaderProgram();
+#endif // COMPACTVERTEXFORMAT_HPP
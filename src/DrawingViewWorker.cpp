@@ -0,0 +1,204 @@
+#include "DrawingViewWorker.hpp"
+#include "TaskPool.hpp"
+#include <algorithm>
+#include <numeric>
+#include <opencascade/BRepBndLib.hxx>
+#include <opencascade/Bnd_Box.hxx>
+#include <opencascade/BRep_Tool.hxx>
+#include <opencascade/HLRAlgo_Projector.hxx>
+#include <opencascade/HLRBRep_PolyAlgo.hxx>
+#include <opencascade/HLRBRep_PolyHLRToShape.hxx>
+#include <opencascade/TopExp.hxx>
+#include <opencascade/TopExp_Explorer.hxx>
+#include <opencascade/TopoDS.hxx>
+#include <opencascade/TopoDS_Vertex.hxx>
+
+// Most shapes handed to one HLRBRep_PolyAlgo run, which is how long a cancel
+// may have to wait.
+size_t const MAX_SHAPES_PER_HLR_BATCH = 64;
+
+namespace {
+// Appends the straight edges of an HLR result, given in the projection
+// plane, as world space segments.
+void collectSegments(TopoDS_Shape const &compound, gp_Trsf const &toWorld,
+                     std::vector<Graphic3d_Vec3> &segments) {
+  if (compound.IsNull()) { return; }
+
+  for (TopExp_Explorer it(compound, TopAbs_EDGE); it.More(); it.Next()) {
+    TopoDS_Vertex first, last;
+    TopExp::Vertices(TopoDS::Edge(it.Current()), first, last);
+    if (first.IsNull() || last.IsNull()) { continue; }
+
+    for (TopoDS_Vertex const &vertex : {first, last}) {
+      gp_Pnt const p = BRep_Tool::Pnt(vertex).Transformed(toWorld);
+      segments.emplace_back(float(p.X()), float(p.Y()), float(p.Z()));
+    }
+  }
+}
+
+// Root of `index` in a union-find forest, with path halving.
+size_t findRoot(std::vector<size_t> &parents, size_t index) {
+  while (parents[index] != index) {
+    parents[index] = parents[parents[index]];
+    index = parents[index];
+  }
+  return index;
+}
+} // namespace
+
+std::vector<std::vector<TopoDS_Shape>>
+DrawingViewWorker::splitIntoBatches(std::vector<TopoDS_Shape> const &shapes,
+                                    gp_Trsf const &toFrame) {
+  // Bounds in the projection frame, where x and y span the drawing plane.
+  std::vector<TopoDS_Shape> loaded;
+  std::vector<Bnd_Box> bounds;
+  for (TopoDS_Shape const &shape : shapes) {
+    if (shape.IsNull()) { continue; }
+    Bnd_Box box;
+    BRepBndLib::Add(shape, box, true);
+    if (box.IsVoid()) { continue; }
+    loaded.push_back(shape);
+    bounds.push_back(box.Transformed(toFrame));
+  }
+
+  // Shapes can only hide each other where their outlines overlap, so every
+  // group of overlapping shapes is computed in one run, swept along x.
+  std::vector<size_t> order(loaded.size());
+  std::iota(order.begin(), order.end(), size_t(0));
+  auto const minX = [&](size_t i) { return bounds[i].CornerMin().X(); };
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return minX(a) < minX(b); });
+  std::vector<size_t> parents(loaded.size());
+  std::iota(parents.begin(), parents.end(), size_t(0));
+  for (size_t i = 0; i < order.size(); ++i) {
+    Bnd_Box const &a = bounds[order[i]];
+    for (size_t j = i + 1;
+         j < order.size() && minX(order[j]) <= a.CornerMax().X(); ++j) {
+      Bnd_Box const &b = bounds[order[j]];
+      if (b.CornerMin().Y() > a.CornerMax().Y() ||
+          a.CornerMin().Y() > b.CornerMax().Y()) {
+        continue;
+      }
+      parents[findRoot(parents, order[i])] = findRoot(parents, order[j]);
+    }
+  }
+
+  std::vector<std::vector<size_t>> groups(loaded.size());
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    groups[findRoot(parents, i)].push_back(i);
+  }
+
+  // Small groups share a batch. A group larger than a batch is split; edges
+  // hidden only by shapes of another of its batches are drawn visible.
+  std::vector<std::vector<TopoDS_Shape>> batches;
+  for (auto const &group : groups) {
+    if (group.empty()) { continue; }
+    if (batches.empty() ||
+        batches.back().size() + group.size() > MAX_SHAPES_PER_HLR_BATCH) {
+      batches.emplace_back();
+    }
+    for (size_t index : group) {
+      if (batches.back().size() >= MAX_SHAPES_PER_HLR_BATCH) {
+        batches.emplace_back();
+      }
+      batches.back().push_back(loaded[index]);
+    }
+  }
+  return batches;
+}
+
+DrawingViewWorker::DrawingViewWorker(std::function<void()> onResult)
+    : state(std::make_shared<State>()) {
+  state->onResult = onResult;
+}
+
+DrawingViewWorker::~DrawingViewWorker() {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->toStop = true;
+  ++state->generation;
+  state->onResult = nullptr;
+}
+
+void DrawingViewWorker::start() {
+  if (state->isRunning || state->toStop) { return; }
+  state->isRunning = true;
+  TaskPool::instance().submit([state = state] { run(*state); });
+}
+
+void DrawingViewWorker::request(std::vector<TopoDS_Shape> shapes,
+                                gp_Ax2 const &frame, int direction) {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->pendingJob =
+      Job{std::move(shapes), frame, direction, ++state->generation};
+  state->result.reset();
+  start();
+}
+
+void DrawingViewWorker::cancel() {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  ++state->generation;
+  state->pendingJob.reset();
+  state->result.reset();
+}
+
+std::shared_ptr<DrawingViewWorker::Drawing const> DrawingViewWorker::takeResult() {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  std::shared_ptr<Drawing const> taken;
+  std::swap(taken, state->result);
+  return taken;
+}
+
+void DrawingViewWorker::run(State &state) {
+  while (true) {
+    Job job;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (state.toStop || !state.pendingJob.has_value()) {
+        state.isRunning = false;
+        return;
+      }
+      job = std::move(state.pendingJob.value());
+      state.pendingJob.reset();
+    }
+
+    std::shared_ptr<Drawing const> drawing = compute(state, job);
+    // Called under the lock, so it never runs once the destructor returned.
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!drawing || state.isCancelled(job)) { continue; }
+    state.result = drawing;
+    state.onResult();
+  }
+}
+
+std::shared_ptr<DrawingViewWorker::Drawing const>
+DrawingViewWorker::compute(State const &state, Job const &job) {
+  gp_Trsf toWorld;
+  toWorld.SetTransformation(gp_Ax3(job.frame));
+  gp_Trsf const toFrame = toWorld;
+  toWorld.Invert();
+
+  std::vector<std::vector<TopoDS_Shape>> batches =
+      splitIntoBatches(job.shapes, toFrame);
+  if (state.isCancelled(job)) { return nullptr; }
+
+  // Update cannot be interrupted, so a cancel takes effect after the batch
+  // being computed.
+  auto drawing = std::make_shared<Drawing>();
+  drawing->direction = job.direction;
+  for (auto const &batch : batches) {
+    Handle(HLRBRep_PolyAlgo) algo = new HLRBRep_PolyAlgo();
+    for (TopoDS_Shape const &shape : batch) { algo->Load(shape); }
+    algo->Projector(HLRAlgo_Projector(job.frame));
+    algo->Update();
+    if (state.isCancelled(job)) { return nullptr; }
+
+    HLRBRep_PolyHLRToShape toShape;
+    toShape.Update(algo);
+    collectSegments(toShape.VCompound(), toWorld, drawing->visible);
+    collectSegments(toShape.OutLineVCompound(), toWorld, drawing->visible);
+    collectSegments(toShape.HCompound(), toWorld, drawing->hidden);
+    collectSegments(toShape.OutLineHCompound(), toWorld, drawing->hidden);
+    if (state.isCancelled(job)) { return nullptr; }
+  }
+  return drawing;
+}
@@ -0,0 +1,84 @@
+#ifndef DRAWINGVIEWWORKER_HPP
+#define DRAWINGVIEWWORKER_HPP
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <opencascade/Graphic3d_Vec3.hxx>
+#include <opencascade/TopoDS_Shape.hxx>
+#include <opencascade/gp_Ax2.hxx>
+#include <opencascade/gp_Trsf.hxx>
+#include <optional>
+#include <vector>
+
+/**
+ * Computes hidden line removal drawings with HLRBRep_PolyAlgo as TaskPool
+ * jobs, from the triangulations the shapes already carry.
+ *
+ * Only the latest request is worked on. Every request and every cancel bumps
+ * a generation counter. The shapes are projected in batches, one
+ * HLRBRep_PolyAlgo run each, and the job checks the counter after every
+ * batch; a superseded computation stops at the next check and its result is
+ * never delivered. Shapes whose outlines overlap share a batch where they
+ * fit, so they still hide each other. At most one job per worker is queued or
+ * running. `onResult` is called from the pool thread once a drawing is ready
+ * to be collected with takeResult.
+ *
+ * The job owns the worker's state along with it, so the destructor never
+ * waits: it cancels the computation and drops `onResult`.
+ */
+class DrawingViewWorker {
+public:
+  // Visible and hidden edges as pairs of segment endpoints, in world space
+  // on the plane of the projection frame.
+  struct Drawing {
+    int direction = 0;
+    std::vector<Graphic3d_Vec3> visible;
+    std::vector<Graphic3d_Vec3> hidden;
+  };
+
+  DrawingViewWorker(std::function<void()> onResult);
+  ~DrawingViewWorker();
+
+  // Projects `shapes` along the z axis of `frame`. `direction` is handed back
+  // with the result.
+  void request(std::vector<TopoDS_Shape> shapes, gp_Ax2 const &frame,
+               int direction);
+  void cancel();
+
+  std::shared_ptr<Drawing const> takeResult();
+
+private:
+  struct Job {
+    std::vector<TopoDS_Shape> shapes;
+    gp_Ax2 frame;
+    int direction;
+    unsigned generation;
+  };
+
+  struct State {
+    std::function<void()> onResult;
+    std::atomic<unsigned> generation{0};
+    std::mutex mutex;
+    bool toStop = false;
+    bool isRunning = false;
+    std::optional<Job> pendingJob;
+    std::shared_ptr<Drawing const> result;
+
+    bool isCancelled(Job const &job) const {
+      return generation != job.generation;
+    }
+  };
+  std::shared_ptr<State> state;
+
+  // Submits the job unless it is already on its way. Called with the state's
+  // mutex held.
+  void start();
+  static void run(State &state);
+  static std::shared_ptr<Drawing const> compute(State const &state,
+                                                Job const &job);
+  static std::vector<std::vector<TopoDS_Shape>>
+  splitIntoBatches(std::vector<TopoDS_Shape> const &shapes,
+                   gp_Trsf const &toFrame);
+};
+#endif // DRAWINGVIEWWORKER_HPP
@@ -0,0 +1,76 @@
+#include "FramePump.hpp"
+#include <algorithm>
+#include <emscripten.h>
+
+FramePump &FramePump::instance() {
+  static FramePump pump;
+  return pump;
+}
+
+void FramePump::requestFrame(void *owner, Callback callback) {
+  Request const request(owner, callback);
+  if (std::find(pending.begin(), pending.end(), request) != pending.end()) {
+    return;
+  }
+  pending.push_back(request);
+
+  // Requests made during the frame are armed once it is over.
+  if (!isArmed && !isRunning) {
+    isArmed = true;
+    emscripten_request_animation_frame(onAnimationFrame, this);
+  }
+}
+
+void FramePump::cancel(void *owner) {
+  auto const isOwned = [owner](Request const &request) {
+    return request.first == owner;
+  };
+  pending.erase(std::remove_if(pending.begin(), pending.end(), isOwned),
+                pending.end());
+}
+
+EM_BOOL FramePump::onAnimationFrame(double time, void *userData) {
+  static_cast<FramePump *>(userData)->runFrame(time);
+  return EM_FALSE;
+}
+
+void FramePump::runFrame(double time) {
+  isArmed = false;
+  isRunning = true;
+  double const start = emscripten_get_now();
+
+  // Callbacks may request frames, e.g. message handling that leads to a
+  // redraw. Those run in this frame unless their pair already did.
+  std::vector<Request> deferred;
+  while (!pending.empty()) {
+    Request const request = pending.front();
+    pending.erase(pending.begin());
+    if (std::find(ranThisFrame.begin(), ranThisFrame.end(), request) !=
+        ranThisFrame.end()) {
+      if (std::find(deferred.begin(), deferred.end(), request) ==
+          deferred.end()) {
+        deferred.push_back(request);
+      }
+      continue;
+    }
+    ranThisFrame.push_back(request);
+    request.second(request.first);
+  }
+
+  double const frameMs = emscripten_get_now() - start;
+  stats.frames++;
+  stats.lastFrameMs = frameMs;
+  stats.maxFrameMs = std::max(stats.maxFrameMs, frameMs);
+  stats.averageFrameMs += (frameMs - stats.averageFrameMs) / stats.frames;
+  stats.lastIntervalMs = lastFrameTime > 0.0 ? time - lastFrameTime : 0.0;
+  stats.lastCallbacks = ranThisFrame.size();
+  lastFrameTime = time;
+
+  ranThisFrame.clear();
+  pending = std::move(deferred);
+  isRunning = false;
+  if (!pending.empty()) {
+    isArmed = true;
+    emscripten_request_animation_frame(onAnimationFrame, this);
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef FRAMEPUMP_HPP
+#define FRAMEPUMP_HPP
+#include <emscripten/html5.h>
+#include <utility>
+#include <vector>
+
+/**
+ * The one requestAnimationFrame loop of the page, shared by all viewers.
+ *
+ * Anything that needs to run on the next frame, such as a viewer's message
+ * handling or redraw, asks for it with requestFrame. Each callback and owner
+ * pair runs at most once per frame. A request made while it runs, or after
+ * it already ran this frame, waits for the next one. While nobody asks for a
+ * frame no callback is armed. Main thread only.
+ */
+class FramePump {
+public:
+  typedef void (*Callback)(void *owner);
+
+  struct Stats {
+    size_t frames = 0;
+    double lastFrameMs = 0.0; // time spent in the callbacks
+    double maxFrameMs = 0.0;
+    double averageFrameMs = 0.0;
+    double lastIntervalMs = 0.0; // between the last two frames
+    size_t lastCallbacks = 0;
+  };
+
+  static FramePump &instance();
+
+  void requestFrame(void *owner, Callback callback);
+  // Drops the pending requests of an owner that goes away.
+  void cancel(void *owner);
+
+  Stats const &getStats() const { return stats; }
+
+private:
+  typedef std::pair<void *, Callback> Request;
+
+  std::vector<Request> pending;
+  std::vector<Request> ranThisFrame;
+  bool isArmed = false;
+  bool isRunning = false;
+  double lastFrameTime = 0.0;
+  Stats stats;
+
+  FramePump() = default;
+  static EM_BOOL onAnimationFrame(double time, void *userData);
+  void runFrame(double time);
+};
+#endif // FRAMEPUMP_HPP
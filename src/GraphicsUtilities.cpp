@@ -174,7 +174,7 @@ EMSCRIPTEN_WEBGL_CONTEXT_HANDLE setupWebGLContext(std::string const &canvasId) {
 
   attrs.alpha = 0;
   attrs.depth = 0;
-  attrs.stencil = 0;
+  attrs.stencil = 1; // capping of section planes
   attrs.antialias = 0;
   attrs.preserveDrawingBuffer = 0;
   attrs.failIfMajorPerformanceCaveat = 0;
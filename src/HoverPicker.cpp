@@ -0,0 +1,230 @@
+#include "HoverPicker.hpp"
+#include "TaskPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <opencascade/BVH_BinnedBuilder.hxx>
+
+HoverPicker::HoverPicker(std::function<void()> onResult)
+    : state(std::make_shared<State>()) {
+  state->onResult = onResult;
+}
+
+HoverPicker::~HoverPicker() {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->toStop = true;
+  state->onResult = nullptr;
+}
+
+void HoverPicker::start(bool isUrgent) {
+  if (state->isRunning || state->toStop) { return; }
+  state->isRunning = true;
+  TaskPool::instance().submit([state = state] { run(*state); }, isUrgent);
+}
+
+void HoverPicker::setMeshes(std::vector<Handle(Poly_Triangulation)> meshes) {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->pendingMeshes = std::move(meshes);
+  state->pendingRay.reset();
+  state->result.reset();
+  start(false);
+}
+
+void HoverPicker::request(gp_Lin const &ray) {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->pendingRay = ray;
+  start(true);
+}
+
+void HoverPicker::setHiddenParts(std::vector<bool> hidden) {
+  auto shared = std::make_shared<std::vector<bool> const>(std::move(hidden));
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->hiddenParts = std::move(shared);
+}
+
+void HoverPicker::setClipPlanes(std::vector<Graphic3d_Vec4> planes) {
+  auto shared =
+      std::make_shared<std::vector<Graphic3d_Vec4> const>(std::move(planes));
+  std::lock_guard<std::mutex> lock(state->mutex);
+  state->clipPlanes = std::move(shared);
+}
+
+bool HoverPicker::takeResult(int &partIndex) {
+  std::lock_guard<std::mutex> lock(state->mutex);
+  if (!state->result.has_value()) { return false; }
+  partIndex = state->result.value();
+  state->result.reset();
+  return true;
+}
+
+void HoverPicker::run(State &state) {
+  while (true) {
+    std::optional<std::vector<Handle(Poly_Triangulation)>> meshes;
+    std::optional<gp_Lin> ray;
+    std::shared_ptr<std::vector<bool> const> hidden;
+    std::shared_ptr<std::vector<Graphic3d_Vec4> const> planes;
+    {
+      std::lock_guard<std::mutex> lock(state.mutex);
+      if (state.toStop ||
+          (!state.pendingMeshes.has_value() && !state.pendingRay.has_value())) {
+        state.isRunning = false;
+        return;
+      }
+      std::swap(meshes, state.pendingMeshes);
+      std::swap(ray, state.pendingRay);
+      hidden = state.hiddenParts;
+      planes = state.clipPlanes;
+    }
+
+    if (meshes.has_value()) {
+      // The old BVH goes first, so both are never held at once.
+      state.triangles.Nullify();
+      state.triangles = build(meshes.value());
+    }
+    if (!ray.has_value()) { continue; }
+
+    int const partIndex =
+        pick(state.triangles, ray.value(), hidden.get(), planes.get());
+    // Called under the lock, so it never runs once the destructor returned.
+    std::lock_guard<std::mutex> lock(state.mutex);
+    // A scene replaced meanwhile makes the answer meaningless.
+    if (state.toStop || state.pendingMeshes.has_value()) { continue; }
+    state.result = partIndex;
+    state.onResult();
+  }
+}
+
+Handle(HoverPicker::Triangles)
+HoverPicker::build(std::vector<Handle(Poly_Triangulation)> const &meshes) {
+  size_t nbTriangles = 0;
+  for (auto const &mesh : meshes) {
+    nbTriangles += mesh.IsNull() ? 0 : mesh->NbTriangles();
+  }
+  if (nbTriangles == 0) { return Handle(Triangles)(); }
+
+  Handle(Triangles) newTriangles = new Triangles(
+      new BVH_BinnedBuilder<Standard_ShortReal, 3, BVH_Constants_NbBinsOptimal>(
+          BVH_Constants_LeafNodeSizeAverage, BVH_Constants_MaxTreeDepth));
+  newTriangles->Elements.reserve(nbTriangles);
+  for (size_t partIndex = 0; partIndex < meshes.size(); ++partIndex) {
+    Handle(Poly_Triangulation) const &mesh = meshes[partIndex];
+    if (mesh.IsNull()) { continue; }
+
+    int const offset = static_cast<int>(newTriangles->Vertices.size()) - 1;
+    for (Standard_Integer i = 1; i <= mesh->NbNodes(); ++i) {
+      gp_Pnt const node = mesh->Node(i);
+      newTriangles->Vertices.push_back(
+          BVH_Vec3f(float(node.X()), float(node.Y()), float(node.Z())));
+    }
+    for (Standard_Integer i = 1; i <= mesh->NbTriangles(); ++i) {
+      Standard_Integer n1, n2, n3;
+      mesh->Triangle(i).Get(n1, n2, n3);
+      newTriangles->Elements.push_back(BVH_Vec4i(
+          offset + n1, offset + n2, offset + n3, static_cast<int>(partIndex)));
+    }
+  }
+  newTriangles->MarkDirty();
+  newTriangles->BVH();
+  return newTriangles;
+}
+
+int HoverPicker::pick(Handle(Triangles) const &triangles, gp_Lin const &ray,
+                      std::vector<bool> const *hidden,
+                      std::vector<Graphic3d_Vec4> const *planes) {
+  if (triangles.IsNull()) { return -1; }
+  BVH_Tree<Standard_ShortReal, 3> const &tree = *triangles->BVH();
+  if (tree.Length() == 0) { return -1; }
+
+  BVH_Vec3f const origin(float(ray.Location().X()), float(ray.Location().Y()),
+                         float(ray.Location().Z()));
+  BVH_Vec3f const direction(float(ray.Direction().X()),
+                            float(ray.Direction().Y()),
+                            float(ray.Direction().Z()));
+  float constexpr BIG = std::numeric_limits<float>::max();
+  BVH_Vec3f const inverse(direction.x() != 0.0f ? 1.0f / direction.x() : BIG,
+                          direction.y() != 0.0f ? 1.0f / direction.y() : BIG,
+                          direction.z() != 0.0f ? 1.0f / direction.z() : BIG);
+
+  auto isClipped = [&](float t) {
+    if (planes == nullptr) { return false; }
+    BVH_Vec3f const p = origin + direction * t;
+    for (Graphic3d_Vec4 const &plane : *planes) {
+      if (plane.x() * p.x() + plane.y() * p.y() + plane.z() * p.z() +
+              plane.w() <
+          0.0f) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Entry distance of the ray into a node's box, or BIG on a miss.
+  auto enterNode = [&](int node, float maxDistance) {
+    BVH_Vec3f const t0 = (tree.MinPoint(node) - origin) * inverse;
+    BVH_Vec3f const t1 = (tree.MaxPoint(node) - origin) * inverse;
+    BVH_Vec3f const tMin = t0.cwiseMin(t1);
+    BVH_Vec3f const tMax = t0.cwiseMax(t1);
+    float const enter = std::max(tMin.maxComp(), 0.0f);
+    float const leave = std::min(tMax.minComp(), maxDistance);
+    return enter <= leave ? enter : BIG;
+  };
+
+  float nearest = BIG;
+  int partIndex = -1;
+  int stack[BVH_Constants_MaxTreeDepth * 2];
+  int stackSize = 0;
+  int node = 0;
+  if (enterNode(node, nearest) == BIG) { return -1; }
+
+  while (true) {
+    if (tree.IsOuter(node)) {
+      for (int i = tree.BegPrimitive(node); i <= tree.EndPrimitive(node); ++i) {
+        BVH_Vec4i const &element = triangles->Elements[i];
+        if (hidden != nullptr && size_t(element.w()) < hidden->size() &&
+            (*hidden)[element.w()]) {
+          continue;
+        }
+        BVH_Vec3f const &p0 = triangles->Vertices[element.x()];
+        BVH_Vec3f const e1 = triangles->Vertices[element.y()] - p0;
+        BVH_Vec3f const e2 = triangles->Vertices[element.z()] - p0;
+
+        // Möller-Trumbore, accepting both windings.
+        BVH_Vec3f const p = BVH_Vec3f::Cross(direction, e2);
+        float const det = e1.Dot(p);
+        if (std::abs(det) < 1e-12f) { continue; }
+        float const invDet = 1.0f / det;
+        BVH_Vec3f const s = origin - p0;
+        float const u = s.Dot(p) * invDet;
+        if (u < 0.0f || u > 1.0f) { continue; }
+        BVH_Vec3f const q = BVH_Vec3f::Cross(s, e1);
+        float const v = direction.Dot(q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) { continue; }
+        float const t = e2.Dot(q) * invDet;
+        if (t > 0.0f && t < nearest && !isClipped(t)) {
+          nearest = t;
+          partIndex = element.w();
+        }
+      }
+    } else {
+      int const left = tree.Child<0>(node);
+      int const right = tree.Child<1>(node);
+      float const enterLeft = enterNode(left, nearest);
+      float const enterRight = enterNode(right, nearest);
+      if (enterLeft != BIG && enterRight != BIG) {
+        // Nearer child first, the other one later.
+        bool const leftFirst = enterLeft <= enterRight;
+        stack[stackSize++] = leftFirst ? right : left;
+        node = leftFirst ? left : right;
+        continue;
+      }
+      if (enterLeft != BIG || enterRight != BIG) {
+        node = enterLeft != BIG ? left : right;
+        continue;
+      }
+    }
+
+    if (stackSize == 0) { break; }
+    node = stack[--stackSize];
+  }
+  return partIndex;
+}
@@ -0,0 +1,79 @@
+#ifndef HOVERPICKER_HPP
+#define HOVERPICKER_HPP
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <opencascade/BVH_Triangulation.hxx>
+#include <opencascade/Graphic3d_Vec4.hxx>
+#include <opencascade/Poly_Triangulation.hxx>
+#include <opencascade/gp_Lin.hxx>
+#include <optional>
+#include <vector>
+
+/**
+ * Finds the part under the cursor on the TaskPool, so mouse moves cost the
+ * main thread no more than handing over a ray.
+ *
+ * The picker keeps a triangle BVH over the meshes of all parts, with the part
+ * index stored in the fourth component of every element. Requests go into a
+ * single slot: a new ray replaces one the job has not started on yet, so
+ * the job only ever works on the latest cursor position. At most one job per
+ * picker is queued or running; it keeps going while there is work in the
+ * slots. Jobs for a ray go ahead of the pool's other tasks. Every finished
+ * query calls `onResult` from the pool thread; the result itself is
+ * collected with takeResult on the main thread.
+ *
+ * The job owns the picker's state along with it, so the destructor never
+ * waits: it only stops the job and drops `onResult`.
+ */
+class HoverPicker {
+public:
+  HoverPicker(std::function<void()> onResult);
+  ~HoverPicker();
+
+  // Replaces the scene. Entry i holds the mesh of part i and may be null.
+  // The BVH is built by the picker's job.
+  void setMeshes(std::vector<Handle(Poly_Triangulation)> meshes);
+  void request(gp_Lin const &ray);
+
+  // Parts flagged here are seen through. Indices past the end are visible.
+  void setHiddenParts(std::vector<bool> hidden);
+
+  // Plane equations of the section planes. Hits where a plane's equation is
+  // negative are clipped away, as in the renderer.
+  void setClipPlanes(std::vector<Graphic3d_Vec4> planes);
+
+  // Index of the nearest part hit by the latest finished ray, or -1. Returns
+  // false when no query finished since the last call.
+  bool takeResult(int &partIndex);
+
+private:
+  typedef BVH_Triangulation<Standard_ShortReal, 3> Triangles;
+
+  struct State {
+    std::function<void()> onResult;
+    std::mutex mutex;
+    bool toStop = false;
+    bool isRunning = false;
+    std::optional<std::vector<Handle(Poly_Triangulation)>> pendingMeshes;
+    std::optional<gp_Lin> pendingRay;
+    std::optional<int> result;
+    std::shared_ptr<std::vector<bool> const> hiddenParts;
+    std::shared_ptr<std::vector<Graphic3d_Vec4> const> clipPlanes;
+
+    // Only touched by the picker's job.
+    Handle(Triangles) triangles;
+  };
+  std::shared_ptr<State> state;
+
+  // Submits the job unless it is already on its way. Called with the state's
+  // mutex held.
+  void start(bool isUrgent);
+  static void run(State &state);
+  static Handle(Triangles)
+  build(std::vector<Handle(Poly_Triangulation)> const &meshes);
+  static int pick(Handle(Triangles) const &triangles, gp_Lin const &ray,
+                  std::vector<bool> const *hidden,
+                  std::vector<Graphic3d_Vec4> const *planes);
+};
+#endif // HOVERPICKER_HPP
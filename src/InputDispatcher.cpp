@@ -0,0 +1,115 @@
+#include "InputDispatcher.hpp"
+#include "FramePump.hpp"
+#include "StaircaseViewController.hpp"
+#include <algorithm>
+
+InputDispatcher &InputDispatcher::instance() {
+  static InputDispatcher dispatcher;
+  return dispatcher;
+}
+
+void InputDispatcher::add(StaircaseViewController *viewer) {
+  if (!isListening) { listen(); }
+  if (std::find(viewers.begin(), viewers.end(), viewer) == viewers.end()) {
+    viewers.push_back(viewer);
+  }
+}
+
+void InputDispatcher::remove(StaircaseViewController *viewer) {
+  viewers.erase(std::remove(viewers.begin(), viewers.end(), viewer),
+                viewers.end());
+  if (dragOwner == viewer) { dragOwner = nullptr; }
+  if (hoverOwner == viewer) { hoverOwner = nullptr; }
+}
+
+void InputDispatcher::listen() {
+  isListening = true;
+  auto windowTarget = EMSCRIPTEN_EVENT_TARGET_WINDOW;
+  const EM_BOOL useCapture = EM_TRUE;
+
+  // clang-format off
+  emscripten_set_resize_callback   (windowTarget, this, useCapture, onResizeEvent);
+  emscripten_set_mouseup_callback  (windowTarget, this, useCapture, onMouseEvent);
+  emscripten_set_mousemove_callback(windowTarget, this, useCapture, onMouseEvent);
+  // clang-format on
+}
+
+StaircaseViewController *InputDispatcher::pointerOwner() const {
+  return dragOwner != nullptr ? dragOwner : hoverOwner;
+}
+
+void InputDispatcher::onCanvasMouseEvent(StaircaseViewController *viewer,
+                                         int eventType,
+                                         EmscriptenMouseEvent const *event) {
+  switch (eventType) {
+  case EMSCRIPTEN_EVENT_MOUSEDOWN:
+    flushMove();
+    dragOwner = viewer;
+    break;
+  case EMSCRIPTEN_EVENT_MOUSEENTER: hoverOwner = viewer; break;
+  case EMSCRIPTEN_EVENT_MOUSELEAVE:
+    if (hoverOwner != viewer) { break; }
+    // The viewer still needs the move that takes the pointer off it, or
+    // its highlight would stay behind. Canvas events carry the same client
+    // position as window ones.
+    flushMove();
+    if (dragOwner != viewer) {
+      EmscriptenMouseEvent leaveMove = *event;
+      leaveMove.targetX = event->clientX;
+      leaveMove.targetY = event->clientY;
+      viewer->onMouseEvent(EMSCRIPTEN_EVENT_MOUSEMOVE, &leaveMove);
+    }
+    hoverOwner = nullptr;
+    break;
+  default: break;
+  }
+}
+
+void InputDispatcher::flushMove() {
+  if (!hasMove) { return; }
+  hasMove = false;
+  if (StaircaseViewController *owner = pointerOwner()) {
+    owner->onMouseEvent(EMSCRIPTEN_EVENT_MOUSEMOVE, &latestMove);
+  }
+}
+
+EM_BOOL InputDispatcher::onMouseEvent(int eventType,
+                                      EmscriptenMouseEvent const *event,
+                                      void *userData) {
+  auto dispatcher = static_cast<InputDispatcher *>(userData);
+  if (eventType == EMSCRIPTEN_EVENT_MOUSEMOVE) {
+    // Moves over no viewer concern nobody.
+    if (dispatcher->pointerOwner() == nullptr) { return EM_FALSE; }
+    dispatcher->latestMove = *event;
+    if (!dispatcher->hasMove) {
+      dispatcher->hasMove = true;
+      FramePump::instance().requestFrame(dispatcher, onFrame);
+    }
+    return EM_FALSE;
+  }
+
+  if (eventType == EMSCRIPTEN_EVENT_MOUSEUP) {
+    dispatcher->flushMove();
+    StaircaseViewController *owner = dispatcher->pointerOwner();
+    // The drag lasts until the last button is released.
+    if (event->buttons == 0) { dispatcher->dragOwner = nullptr; }
+    if (owner != nullptr) { owner->onMouseEvent(eventType, event); }
+  }
+  return EM_FALSE;
+}
+
+EM_BOOL InputDispatcher::onResizeEvent(int eventType,
+                                       EmscriptenUiEvent const *event,
+                                       void *userData) {
+  auto dispatcher = static_cast<InputDispatcher *>(userData);
+  // A copy, in case a viewer goes away while handling the event.
+  std::vector<StaircaseViewController *> const viewers = dispatcher->viewers;
+  for (StaircaseViewController *viewer : viewers) {
+    viewer->onResizeEvent(eventType, event);
+  }
+  return EM_FALSE;
+}
+
+void InputDispatcher::onFrame(void *userData) {
+  static_cast<InputDispatcher *>(userData)->flushMove();
+}
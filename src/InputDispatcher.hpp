@@ -0,0 +1,49 @@
+#ifndef INPUTDISPATCHER_HPP
+#define INPUTDISPATCHER_HPP
+#include <emscripten/html5.h>
+#include <vector>
+
+class StaircaseViewController;
+
+/**
+ * The window listeners of all viewers on the page, registered once.
+ *
+ * Mouse moves and releases outside a canvas still matter to the viewer that
+ * is being dragged, so they are listened for on the window. Instead of every
+ * viewer handling every event, they go to the one viewer that owns the
+ * pointer: the one a drag started in, else the one under the pointer. Moves
+ * are coalesced to the latest one per frame, while releases flush the move
+ * before them first. Resizes go to every viewer. Main thread only.
+ */
+class InputDispatcher {
+public:
+  static InputDispatcher &instance();
+
+  void add(StaircaseViewController *viewer);
+  void remove(StaircaseViewController *viewer);
+
+  // Ownership bookkeeping for the canvas events of `viewer`, called before
+  // the viewer handles them itself.
+  void onCanvasMouseEvent(StaircaseViewController *viewer, int eventType,
+                          EmscriptenMouseEvent const *event);
+
+private:
+  std::vector<StaircaseViewController *> viewers;
+  StaircaseViewController *dragOwner = nullptr;
+  StaircaseViewController *hoverOwner = nullptr;
+  EmscriptenMouseEvent latestMove;
+  bool hasMove = false;
+  bool isListening = false;
+
+  InputDispatcher() = default;
+  void listen();
+  StaircaseViewController *pointerOwner() const;
+  void flushMove();
+
+  static EM_BOOL onMouseEvent(int eventType, EmscriptenMouseEvent const *event,
+                              void *userData);
+  static EM_BOOL onResizeEvent(int eventType, EmscriptenUiEvent const *event,
+                               void *userData);
+  static void onFrame(void *userData);
+};
+#endif // INPUTDISPATCHER_HPP
@@ -0,0 +1,421 @@
+#include "MeshDecimator.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Triangulations smaller than this are drawn as-is at every level.
+size_t const MIN_DECIMATION_TRIANGLES = 64;
+
+// Weight of the planes that pin open borders in place.
+double const BOUNDARY_PENALTY = 1000.0;
+
+// Smallest cosine allowed between a triangle normal before and after a
+// collapse. Anything below is treated as a fold-over.
+double const MIN_NORMAL_COSINE = 0.2;
+
+struct Vec3 {
+  double x, y, z;
+};
+
+Vec3 operator-(Vec3 const &a, Vec3 const &b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+Vec3 cross(Vec3 const &a, Vec3 const &b) {
+  return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+          a.x * b.y - a.y * b.x};
+}
+
+double dot(Vec3 const &a, Vec3 const &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+double length(Vec3 const &a) { return std::sqrt(dot(a, a)); }
+
+/**
+ * Symmetric 4x4 error quadric, stored as its upper triangle.
+ */
+struct Quadric {
+  std::array<double, 10> m{};
+
+  static Quadric fromPlane(Vec3 const &n, double d, double weight) {
+    Quadric q;
+    q.m = {n.x * n.x, n.x * n.y, n.x * n.z, n.x * d, n.y * n.y,
+           n.y * n.z, n.y * d,   n.z * n.z, n.z * d, d * d};
+    for (double &v : q.m) { v *= weight; }
+    return q;
+  }
+
+  Quadric &operator+=(Quadric const &other) {
+    for (size_t i = 0; i < m.size(); ++i) { m[i] += other.m[i]; }
+    return *this;
+  }
+
+  double evaluate(Vec3 const &p) const {
+    return m[0] * p.x * p.x + 2 * m[1] * p.x * p.y + 2 * m[2] * p.x * p.z +
+           2 * m[3] * p.x + m[4] * p.y * p.y + 2 * m[5] * p.y * p.z +
+           2 * m[6] * p.y + m[7] * p.z * p.z + 2 * m[8] * p.z + m[9];
+  }
+
+  // Position minimizing the error, if the system is well conditioned.
+  bool optimum(Vec3 &p) const {
+    double const a = m[0], b = m[1], c = m[2], e = m[4], f = m[5], i = m[7];
+    double const det = a * (e * i - f * f) - b * (b * i - f * c) +
+                       c * (b * f - e * c);
+    double const scale = std::abs(a) + std::abs(e) + std::abs(i);
+    if (std::abs(det) <= 1e-9 * scale * scale * scale) { return false; }
+
+    double const rx = -m[3], ry = -m[6], rz = -m[8];
+    p.x = (rx * (e * i - f * f) - b * (ry * i - f * rz) +
+           c * (ry * f - e * rz)) /
+          det;
+    p.y = (a * (ry * i - f * rz) - rx * (b * i - f * c) +
+           c * (b * rz - ry * c)) /
+          det;
+    p.z = (a * (e * rz - ry * f) - b * (b * rz - ry * c) +
+           rx * (b * f - e * c)) /
+          det;
+    return true;
+  }
+};
+
+struct Collapse {
+  double cost;
+  uint32_t v0, v1;
+  uint32_t version0, version1;
+  Vec3 target;
+
+  bool operator>(Collapse const &other) const { return cost > other.cost; }
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+  if (a > b) { std::swap(a, b); }
+  return (uint64_t(a) << 32) | b;
+}
+
+struct PositionKey {
+  uint32_t bits[3];
+  bool operator==(PositionKey const &other) const {
+    return std::memcmp(bits, other.bits, sizeof(bits)) == 0;
+  }
+};
+
+struct PositionKeyHash {
+  size_t operator()(PositionKey const &key) const {
+    size_t h = key.bits[0];
+    h = h * 73856093u ^ key.bits[1];
+    h = h * 19349663u ^ key.bits[2];
+    return h;
+  }
+};
+
+PositionKey positionKey(float const *xyz) {
+  PositionKey key;
+  for (int i = 0; i < 3; ++i) {
+    float v = xyz[i] == 0.0f ? 0.0f : xyz[i]; // fold -0 into +0
+    std::memcpy(&key.bits[i], &v, sizeof(float));
+  }
+  return key;
+}
+
+class Decimator {
+public:
+  explicit Decimator(DecimatorMesh const &mesh) { weld(mesh); }
+
+  DecimatorMesh run(size_t targetTriangles) {
+    buildQuadrics();
+    seedCollapses();
+
+    while (liveTriangles > targetTriangles && !heap.empty()) {
+      Collapse c = heap.top();
+      heap.pop();
+      if (!vertexAlive[c.v0] || !vertexAlive[c.v1] ||
+          versions[c.v0] != c.version0 || versions[c.v1] != c.version1) {
+        continue; // stale entry
+      }
+      if (flipsAnyTriangle(c.v0, c.v1, c.target) ||
+          flipsAnyTriangle(c.v1, c.v0, c.target)) {
+        continue;
+      }
+      collapse(c.v0, c.v1, c.target);
+    }
+    return compact();
+  }
+
+private:
+  std::vector<Vec3> positions;
+  std::vector<Quadric> quadrics;
+  std::vector<uint32_t> versions;
+  std::vector<bool> vertexAlive;
+  std::vector<std::vector<uint32_t>> vertexTriangles;
+
+  std::vector<uint32_t> triangles;
+  std::vector<bool> triangleAlive;
+  size_t liveTriangles = 0;
+
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>
+      heap;
+
+  void weld(DecimatorMesh const &mesh) {
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+    size_t const nbVertices = mesh.positions.size() / 3;
+    std::vector<uint32_t> remap(nbVertices);
+    welded.reserve(nbVertices);
+    for (size_t i = 0; i < nbVertices; ++i) {
+      float const *xyz = &mesh.positions[i * 3];
+      auto [it, inserted] = welded.emplace(
+          positionKey(xyz), static_cast<uint32_t>(positions.size()));
+      if (inserted) { positions.push_back({xyz[0], xyz[1], xyz[2]}); }
+      remap[i] = it->second;
+    }
+
+    triangles.reserve(mesh.indices.size());
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+      uint32_t a = remap[mesh.indices[t]];
+      uint32_t b = remap[mesh.indices[t + 1]];
+      uint32_t c = remap[mesh.indices[t + 2]];
+      if (a == b || b == c || a == c) { continue; }
+      triangles.insert(triangles.end(), {a, b, c});
+    }
+
+    size_t const nbTriangles = triangles.size() / 3;
+    triangleAlive.assign(nbTriangles, true);
+    liveTriangles = nbTriangles;
+
+    vertexAlive.assign(positions.size(), true);
+    versions.assign(positions.size(), 0);
+    vertexTriangles.resize(positions.size());
+    for (uint32_t t = 0; t < nbTriangles; ++t) {
+      for (int k = 0; k < 3; ++k) {
+        vertexTriangles[triangles[t * 3 + k]].push_back(t);
+      }
+    }
+  }
+
+  Vec3 triangleNormal(uint32_t t) const {
+    Vec3 const &a = positions[triangles[t * 3]];
+    Vec3 const &b = positions[triangles[t * 3 + 1]];
+    Vec3 const &c = positions[triangles[t * 3 + 2]];
+    return cross(b - a, c - a);
+  }
+
+  void buildQuadrics() {
+    quadrics.assign(positions.size(), Quadric());
+
+    std::unordered_map<uint64_t, int> edgeUse;
+    size_t const nbTriangles = triangles.size() / 3;
+    edgeUse.reserve(nbTriangles * 3);
+    for (uint32_t t = 0; t < nbTriangles; ++t) {
+      for (int k = 0; k < 3; ++k) {
+        ++edgeUse[edgeKey(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3])];
+      }
+    }
+
+    for (uint32_t t = 0; t < nbTriangles; ++t) {
+      Vec3 n = triangleNormal(t);
+      double const area2 = length(n);
+      if (area2 <= 0.0) { continue; }
+      n = {n.x / area2, n.y / area2, n.z / area2};
+      double const d = -dot(n, positions[triangles[t * 3]]);
+      Quadric const q = Quadric::fromPlane(n, d, area2 * 0.5);
+      for (int k = 0; k < 3; ++k) { quadrics[triangles[t * 3 + k]] += q; }
+
+      // Open borders get a perpendicular plane so they do not shrink.
+      for (int k = 0; k < 3; ++k) {
+        uint32_t const a = triangles[t * 3 + k];
+        uint32_t const b = triangles[t * 3 + (k + 1) % 3];
+        if (edgeUse[edgeKey(a, b)] != 1) { continue; }
+        Vec3 const edge = positions[b] - positions[a];
+        Vec3 side = cross(edge, n);
+        double const sideLength = length(side);
+        if (sideLength <= 0.0) { continue; }
+        side = {side.x / sideLength, side.y / sideLength, side.z / sideLength};
+        Quadric const border =
+            Quadric::fromPlane(side, -dot(side, positions[a]),
+                               BOUNDARY_PENALTY * dot(edge, edge));
+        quadrics[a] += border;
+        quadrics[b] += border;
+      }
+    }
+  }
+
+  void pushCollapse(uint32_t v0, uint32_t v1) {
+    Quadric q = quadrics[v0];
+    q += quadrics[v1];
+
+    Vec3 const &p0 = positions[v0];
+    Vec3 const &p1 = positions[v1];
+    Vec3 candidates[4] = {p0, p1,
+                          {(p0.x + p1.x) * 0.5, (p0.y + p1.y) * 0.5,
+                           (p0.z + p1.z) * 0.5},
+                          {}};
+    int nbCandidates = q.optimum(candidates[3]) ? 4 : 3;
+
+    Collapse c{q.evaluate(candidates[0]), v0, v1, versions[v0], versions[v1],
+               candidates[0]};
+    for (int i = 1; i < nbCandidates; ++i) {
+      double const cost = q.evaluate(candidates[i]);
+      if (cost < c.cost) {
+        c.cost = cost;
+        c.target = candidates[i];
+      }
+    }
+    heap.push(c);
+  }
+
+  void seedCollapses() {
+    std::unordered_set<uint64_t> seen;
+    seen.reserve(triangles.size());
+    for (size_t t = 0; t < triangles.size() / 3; ++t) {
+      for (int k = 0; k < 3; ++k) {
+        uint32_t const a = triangles[t * 3 + k];
+        uint32_t const b = triangles[t * 3 + (k + 1) % 3];
+        if (seen.insert(edgeKey(a, b)).second) { pushCollapse(a, b); }
+      }
+    }
+  }
+
+  // Whether moving `moved` to `target` folds over one of the triangles it
+  // keeps after collapsing onto `other`.
+  bool flipsAnyTriangle(uint32_t moved, uint32_t other,
+                        Vec3 const &target) const {
+    for (uint32_t t : vertexTriangles[moved]) {
+      if (!triangleAlive[t]) { continue; }
+      uint32_t const *tri = &triangles[t * 3];
+      if (tri[0] == other || tri[1] == other || tri[2] == other) { continue; }
+
+      Vec3 const before = triangleNormal(t);
+      Vec3 p[3];
+      for (int k = 0; k < 3; ++k) {
+        p[k] = tri[k] == moved ? target : positions[tri[k]];
+      }
+      Vec3 const after = cross(p[1] - p[0], p[2] - p[0]);
+      double const lengths = length(before) * length(after);
+      if (lengths <= 0.0 || dot(before, after) < MIN_NORMAL_COSINE * lengths) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void collapse(uint32_t keep, uint32_t removed, Vec3 const &target) {
+    positions[keep] = target;
+    quadrics[keep] += quadrics[removed];
+    vertexAlive[removed] = false;
+    ++versions[keep];
+    ++versions[removed];
+
+    for (uint32_t t : vertexTriangles[removed]) {
+      if (!triangleAlive[t]) { continue; }
+      uint32_t *tri = &triangles[t * 3];
+      if (tri[0] == keep || tri[1] == keep || tri[2] == keep) {
+        triangleAlive[t] = false;
+        --liveTriangles;
+        continue;
+      }
+      for (int k = 0; k < 3; ++k) {
+        if (tri[k] == removed) { tri[k] = keep; }
+      }
+      vertexTriangles[keep].push_back(t);
+    }
+    vertexTriangles[removed].clear();
+    vertexTriangles[removed].shrink_to_fit();
+
+    auto &keepTriangles = vertexTriangles[keep];
+    keepTriangles.erase(std::remove_if(keepTriangles.begin(),
+                                       keepTriangles.end(),
+                                       [this](uint32_t t) {
+                                         return !triangleAlive[t];
+                                       }),
+                        keepTriangles.end());
+
+    std::unordered_set<uint32_t> neighbours;
+    for (uint32_t t : keepTriangles) {
+      for (int k = 0; k < 3; ++k) {
+        uint32_t const v = triangles[t * 3 + k];
+        if (v != keep && neighbours.insert(v).second) { pushCollapse(keep, v); }
+      }
+    }
+  }
+
+  DecimatorMesh compact() const {
+    DecimatorMesh out;
+    std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+    for (size_t t = 0; t < triangleAlive.size(); ++t) {
+      if (!triangleAlive[t]) { continue; }
+      for (int k = 0; k < 3; ++k) {
+        uint32_t const v = triangles[t * 3 + k];
+        if (remap[v] == UINT32_MAX) {
+          remap[v] = static_cast<uint32_t>(out.positions.size() / 3);
+          out.positions.insert(out.positions.end(),
+                               {static_cast<float>(positions[v].x),
+                                static_cast<float>(positions[v].y),
+                                static_cast<float>(positions[v].z)});
+        }
+        out.indices.push_back(remap[v]);
+      }
+    }
+    return out;
+  }
+};
+
+} // namespace
+
+DecimatorMesh decimateMesh(DecimatorMesh const &mesh, size_t targetTriangles) {
+  return Decimator(mesh).run(targetTriangles);
+}
+
+Handle(Poly_Triangulation)
+    decimateTriangulation(Handle(Poly_Triangulation) const &triangulation,
+                          double ratio) {
+  if (triangulation.IsNull() ||
+      size_t(triangulation->NbTriangles()) < MIN_DECIMATION_TRIANGLES) {
+    return Handle(Poly_Triangulation)();
+  }
+
+  DecimatorMesh mesh;
+  mesh.positions.reserve(triangulation->NbNodes() * 3);
+  for (Standard_Integer i = 1; i <= triangulation->NbNodes(); ++i) {
+    gp_Pnt const node = triangulation->Node(i);
+    mesh.positions.insert(mesh.positions.end(),
+                          {static_cast<float>(node.X()),
+                           static_cast<float>(node.Y()),
+                           static_cast<float>(node.Z())});
+  }
+  mesh.indices.reserve(triangulation->NbTriangles() * 3);
+  for (Standard_Integer i = 1; i <= triangulation->NbTriangles(); ++i) {
+    Standard_Integer n1, n2, n3;
+    triangulation->Triangle(i).Get(n1, n2, n3);
+    mesh.indices.insert(mesh.indices.end(),
+                        {uint32_t(n1 - 1), uint32_t(n2 - 1), uint32_t(n3 - 1)});
+  }
+
+  size_t const target = std::max<size_t>(
+      4, static_cast<size_t>(triangulation->NbTriangles() * ratio));
+  DecimatorMesh reduced = decimateMesh(mesh, target);
+  if (reduced.indices.empty()) { return Handle(Poly_Triangulation)(); }
+
+  Standard_Integer const nbNodes =
+      static_cast<Standard_Integer>(reduced.positions.size() / 3);
+  Standard_Integer const nbTriangles =
+      static_cast<Standard_Integer>(reduced.indices.size() / 3);
+  Handle(Poly_Triangulation) proxy =
+      new Poly_Triangulation(nbNodes, nbTriangles, Standard_False);
+  for (Standard_Integer i = 0; i < nbNodes; ++i) {
+    float const *xyz = &reduced.positions[i * 3];
+    proxy->SetNode(i + 1, gp_Pnt(xyz[0], xyz[1], xyz[2]));
+  }
+  for (Standard_Integer i = 0; i < nbTriangles; ++i) {
+    uint32_t const *tri = &reduced.indices[i * 3];
+    proxy->SetTriangle(i + 1, Poly_Triangle(tri[0] + 1, tri[1] + 1, tri[2] + 1));
+  }
+  proxy->ComputeNormals();
+  return proxy;
+}
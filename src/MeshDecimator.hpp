@@ -0,0 +1,37 @@
+#ifndef MESHDECIMATOR_HPP
+#define MESHDECIMATOR_HPP
+#include <cstdint>
+#include <opencascade/Poly_Triangulation.hxx>
+#include <vector>
+
+/**
+ * Indexed triangle soup used as the working format of the decimator.
+ */
+struct DecimatorMesh {
+  std::vector<float> positions;  // xyz triplets
+  std::vector<uint32_t> indices; // three per triangle
+};
+
+/**
+ * Simplifies a mesh with quadric-error edge collapses (Garland & Heckbert).
+ * Coincident vertices are welded first so that face seams of a merged BRep
+ * triangulation collapse together instead of tearing open.
+ *
+ * @param mesh The mesh to simplify.
+ * @param targetTriangles Stop once no more than this many triangles remain.
+ * @return The simplified mesh. Returns the welded input when it is already
+ *         below the target.
+ */
+DecimatorMesh decimateMesh(DecimatorMesh const &mesh, size_t targetTriangles);
+
+/**
+ * Produces a reduced copy of a triangulation holding roughly `ratio` of its
+ * triangles, with smooth vertex normals.
+ *
+ * @return A null handle when the triangulation is too small to be worth
+ *         simplifying.
+ */
+Handle(Poly_Triangulation)
+    decimateTriangulation(Handle(Poly_Triangulation) const &triangulation,
+                          double ratio);
+#endif // MESHDECIMATOR_HPP
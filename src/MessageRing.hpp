@@ -0,0 +1,84 @@
+#ifndef MESSAGERING_HPP
+#define MESSAGERING_HPP
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Bounded lock-free queue for many producers and a single consumer, after
+ * Dmitry Vyukov's bounded MPMC queue. All cells are allocated up front.
+ *
+ * Every cell carries a sequence number. A producer claims a position with
+ * one compare-and-swap on the enqueue counter, writes the value and then
+ * publishes it by advancing the cell's sequence; the consumer only reads a
+ * cell once it is published. tryPush fails instead of waiting when the ring
+ * is full.
+ */
+template <typename T, size_t Capacity> class MessageRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  MessageRing() {
+    for (size_t i = 0; i < Capacity; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MessageRing(MessageRing const &) = delete;
+  MessageRing &operator=(MessageRing const &) = delete;
+
+  bool tryPush(T const &value) {
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+      Cell &cell = cells[position & (Capacity - 1)];
+      size_t const sequence = cell.sequence.load(std::memory_order_acquire);
+      std::ptrdiff_t const diff =
+          static_cast<std::ptrdiff_t>(sequence) -
+          static_cast<std::ptrdiff_t>(position);
+      if (diff == 0) {
+        if (enqueuePosition.compare_exchange_weak(position, position + 1,
+                                                  std::memory_order_relaxed)) {
+          cell.value = value;
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // full
+      } else {
+        position = enqueuePosition.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Consumer only. Fails when the ring is empty or the oldest claimed cell
+  // is not published yet.
+  bool tryPop(T &value) {
+    Cell &cell = cells[dequeuePosition & (Capacity - 1)];
+    size_t const sequence = cell.sequence.load(std::memory_order_acquire);
+    if (sequence != dequeuePosition + 1) { return false; }
+
+    value = cell.value;
+    cell.sequence.store(dequeuePosition + Capacity, std::memory_order_release);
+    ++dequeuePosition;
+    return true;
+  }
+
+  // Positions handed out so far. The consumer can stop at a snapshot of it
+  // to leave later pushes for another round.
+  size_t pushedCount() const {
+    return enqueuePosition.load(std::memory_order_acquire);
+  }
+  size_t poppedCount() const { return dequeuePosition; }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::array<Cell, Capacity> cells;
+  alignas(64) std::atomic<size_t> enqueuePosition{0};
+  alignas(64) size_t dequeuePosition = 0;
+};
+#endif // MESSAGERING_HPP
@@ -0,0 +1,79 @@
+#include "MessageScheduler.hpp"
+#include "FramePump.hpp"
+#include <algorithm>
+
+MessageScheduler &MessageScheduler::instance() {
+  static MessageScheduler scheduler;
+  return scheduler;
+}
+
+void MessageScheduler::add(void *owner, Handler handler) {
+  if (isRegistered(owner)) { return; }
+  entries.push_back({owner, handler, false, false});
+}
+
+void MessageScheduler::remove(void *owner) {
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [owner](Entry const &entry) {
+                                 return entry.owner == owner;
+                               }),
+                entries.end());
+  if (firstEntry >= entries.size()) { firstEntry = 0; }
+}
+
+void MessageScheduler::wake(void *owner) {
+  for (Entry &entry : entries) {
+    if (entry.owner != owner) { continue; }
+    entry.wantsTurn = true;
+    // Wakes during a tick land on the next frame.
+    if (!entry.isSuspended) {
+      FramePump::instance().requestFrame(this, onFrame);
+    }
+    return;
+  }
+}
+
+void MessageScheduler::setSuspended(void *owner, bool suspended) {
+  for (Entry &entry : entries) {
+    if (entry.owner != owner) { continue; }
+    entry.isSuspended = suspended;
+    if (!suspended && entry.wantsTurn) {
+      FramePump::instance().requestFrame(this, onFrame);
+    }
+    return;
+  }
+}
+
+bool MessageScheduler::isRegistered(void *owner) const {
+  return std::any_of(
+      entries.begin(), entries.end(),
+      [owner](Entry const &entry) { return entry.owner == owner; });
+}
+
+void MessageScheduler::onFrame(void *userData) {
+  static_cast<MessageScheduler *>(userData)->runTick();
+}
+
+void MessageScheduler::runTick() {
+  // Who takes part is settled up front; a viewer woken meanwhile, including
+  // by its own turn, waits for the next tick.
+  std::vector<Entry> turns;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    Entry &entry = entries[(firstEntry + i) % entries.size()];
+    if (!entry.wantsTurn || entry.isSuspended) { continue; }
+    entry.wantsTurn = false;
+    turns.push_back(entry);
+  }
+  if (!entries.empty()) { firstEntry = (firstEntry + 1) % entries.size(); }
+
+  auto const tickEnd = Clock::now() + MESSAGE_TICK_BUDGET;
+  for (size_t i = 0; i < turns.size(); ++i) {
+    // A viewer deleted by an earlier turn.
+    if (!isRegistered(turns[i].owner)) { continue; }
+    auto const now = Clock::now();
+    auto const share = now < tickEnd
+                           ? (tickEnd - now) / Clock::rep(turns.size() - i)
+                           : Clock::duration::zero();
+    turns[i].handler(turns[i].owner, now + share);
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef MESSAGESCHEDULER_HPP
+#define MESSAGESCHEDULER_HPP
+#include <chrono>
+#include <vector>
+
+// Time per frame that message handling of all viewers together may take.
+std::chrono::microseconds const MESSAGE_TICK_BUDGET(10000);
+
+/**
+ * Shares each frame's message handling time between the viewers of the page.
+ *
+ * Viewers register once and ask for a turn with wake. On every frame that
+ * has turns to give, each waiting viewer gets exactly one, with a deadline:
+ * the time left of MESSAGE_TICK_BUDGET split evenly between the viewers still
+ * to go, so time a light viewer leaves unused goes to the ones after it. The
+ * viewer that goes first moves round from frame to frame, so a scene build in
+ * one viewer cannot keep spinners and input of the others waiting. Main
+ * thread only.
+ */
+class MessageScheduler {
+public:
+  typedef std::chrono::steady_clock Clock;
+  typedef void (*Handler)(void *owner, Clock::time_point deadline);
+
+  static MessageScheduler &instance();
+
+  void add(void *owner, Handler handler);
+  void remove(void *owner);
+  // Gives the owner a turn on the next frame.
+  void wake(void *owner);
+  // A suspended owner keeps its wake-ups and gets its turn once resumed.
+  void setSuspended(void *owner, bool suspended);
+
+private:
+  struct Entry {
+    void *owner;
+    Handler handler;
+    bool wantsTurn;
+    bool isSuspended;
+  };
+
+  std::vector<Entry> entries;
+  size_t firstEntry = 0;
+
+  MessageScheduler() = default;
+  static void onFrame(void *userData);
+  void runTick();
+  bool isRegistered(void *owner) const;
+};
+#endif // MESSAGESCHEDULER_HPP
@@ -1,14 +1,29 @@
 #include "OCCTUtilities.hpp"
+#include "MeshDecimator.hpp"
+#include "SceneBounds.hpp"
+#include "TaskPool.hpp"
 #include <GLES2/gl2.h>
 #include <OpenGl_GraphicDriver.hxx>
 #include <Wasm_Window.hxx>
 #include <XCAFDoc_DocumentTool.hxx>
 #include <emscripten.h>
 #include <opencascade/AIS_Shape.hxx>
+#include <opencascade/BRepLib_ToolTriangulatedShape.hxx>
+#include <opencascade/BRep_Tool.hxx>
+#include <opencascade/Poly_Polygon3D.hxx>
+#include <opencascade/Poly_PolygonOnTriangulation.hxx>
+#include <opencascade/Prs3d_Drawer.hxx>
 #include <opencascade/STEPCAFControl_Reader.hxx>
+#include <opencascade/StdPrs_ToolTriangulatedShape.hxx>
 #include <opencascade/TDF_ChildIterator.hxx>
+#include <opencascade/TDF_Tool.hxx>
 #include <opencascade/TDataStd_Name.hxx>
 #include <opencascade/TDocStd_Document.hxx>
+#include <opencascade/TopExp_Explorer.hxx>
+#include <opencascade/TopTools_IndexedDataMapOfShapeListOfShape.hxx>
+#include <opencascade/TopTools_IndexedMapOfShape.hxx>
+#include <opencascade/TopTools_MapOfShape.hxx>
+#include <opencascade/TopoDS.hxx>
 #include <opencascade/XCAFDoc_ColorTool.hxx>
 #include <opencascade/XCAFDoc_ShapeTool.hxx>
 #include <unordered_set>
@@ -107,9 +122,9 @@ std::string ShapeEnumToString(TopAbs_ShapeEnum shapeType) {
     }
 }
 
-std::vector<TopoDS_Shape> getShapesFromDoc(Handle(TDocStd_Document)
-                                               const aDoc) {
-    std::vector<TopoDS_Shape> shapes;
+std::vector<std::pair<TDF_Label, TopoDS_Shape>>
+getLabeledShapesFromDoc(Handle(TDocStd_Document) const aDoc) {
+    std::vector<std::pair<TDF_Label, TopoDS_Shape>> shapes;
     TDF_Label mainLabel = aDoc->Main();
     Handle(XCAFDoc_ShapeTool) shapeTool =
         XCAFDoc_DocumentTool::ShapeTool(mainLabel);
@@ -129,7 +144,7 @@ std::vector<TopoDS_Shape> getShapesFromDoc(Handle(TDocStd_Document)
         continue;
       }
 
-      shapes.push_back(shape);
+      shapes.emplace_back(label, shape);
       seenLabels.insert(label.Tag());
 
       debugOut("[Shape] Label= ", label.Tag(), ", Type= ", shape.ShapeType(), "(",
@@ -137,3 +152,377 @@ std::vector<TopoDS_Shape> getShapesFromDoc(Handle(TDocStd_Document)
     }
     return shapes;
 }
+
+Handle(Poly_Triangulation)
+    mergeTriangulations(TopoDS_Shape const &shape,
+                        std::vector<Standard_Integer> *faceTriangleEnds) {
+  Standard_Integer nbNodes = 0;
+  Standard_Integer nbTriangles = 0;
+  for (TopExp_Explorer it(shape, TopAbs_FACE); it.More(); it.Next()) {
+    TopLoc_Location loc;
+    Handle(Poly_Triangulation) faceTris =
+        BRep_Tool::Triangulation(TopoDS::Face(it.Current()), loc);
+    if (faceTris.IsNull()) { continue; }
+    nbNodes += faceTris->NbNodes();
+    nbTriangles += faceTris->NbTriangles();
+  }
+  if (nbTriangles == 0) { return Handle(Poly_Triangulation)(); }
+
+  Handle(Poly_Triangulation) merged = new Poly_Triangulation(
+      nbNodes, nbTriangles, Standard_False, Standard_True);
+  Standard_Integer nodeOffset = 0;
+  Standard_Integer triangleOffset = 0;
+  for (TopExp_Explorer it(shape, TopAbs_FACE); it.More(); it.Next()) {
+    TopoDS_Face const &face = TopoDS::Face(it.Current());
+    TopLoc_Location loc;
+    Handle(Poly_Triangulation) faceTris = BRep_Tool::Triangulation(face, loc);
+    if (faceTris.IsNull()) { continue; }
+    if (!faceTris->HasNormals()) {
+      BRepLib_ToolTriangulatedShape::ComputeNormals(face, faceTris);
+    }
+
+    gp_Trsf const trsf = loc.Transformation();
+    bool const isReversed = face.Orientation() == TopAbs_REVERSED;
+    for (Standard_Integer i = 1; i <= faceTris->NbNodes(); ++i) {
+      gp_Dir normal = faceTris->Normal(i).Transformed(trsf);
+      if (isReversed) { normal.Reverse(); }
+      merged->SetNode(nodeOffset + i, faceTris->Node(i).Transformed(trsf));
+      merged->SetNormal(nodeOffset + i, normal);
+    }
+    for (Standard_Integer i = 1; i <= faceTris->NbTriangles(); ++i) {
+      Standard_Integer n1, n2, n3;
+      faceTris->Triangle(i).Get(n1, n2, n3);
+      if (isReversed) { std::swap(n2, n3); }
+      merged->SetTriangle(triangleOffset + i,
+                          Poly_Triangle(nodeOffset + n1, nodeOffset + n2,
+                                        nodeOffset + n3));
+    }
+    nodeOffset += faceTris->NbNodes();
+    triangleOffset += faceTris->NbTriangles();
+    if (faceTriangleEnds) { faceTriangleEnds->push_back(triangleOffset); }
+  }
+  return merged;
+}
+
+Handle(Graphic3d_ArrayOfTriangles)
+    createTriangleArray(Handle(Poly_Triangulation) const &triangulation,
+                        Graphic3d_ArrayFlags theFlags) {
+  if (triangulation.IsNull() || !triangulation->HasNormals()) {
+    return Handle(Graphic3d_ArrayOfTriangles)();
+  }
+
+  Handle(Graphic3d_ArrayOfTriangles) triangles = new Graphic3d_ArrayOfTriangles(
+      triangulation->NbNodes(), triangulation->NbTriangles() * 3,
+      Graphic3d_ArrayFlags_VertexNormal | theFlags);
+  for (Standard_Integer i = 1; i <= triangulation->NbNodes(); ++i) {
+    triangles->AddVertex(triangulation->Node(i), triangulation->Normal(i));
+  }
+  for (Standard_Integer i = 1; i <= triangulation->NbTriangles(); ++i) {
+    Standard_Integer n1, n2, n3;
+    triangulation->Triangle(i).Get(n1, n2, n3);
+    triangles->AddEdges(n1, n2, n3);
+  }
+  return triangles;
+}
+
+std::vector<Graphic3d_Vec3> extractEdgeSegments(TopoDS_Shape const &shape) {
+  std::vector<Graphic3d_Vec3> segments;
+  auto addPolyline = [&segments](auto const &nodeAt, Standard_Integer nbNodes,
+                                 gp_Trsf const &trsf) {
+    for (Standard_Integer i = 1; i < nbNodes; ++i) {
+      for (Standard_Integer k : {i, i + 1}) {
+        gp_Pnt const p = nodeAt(k).Transformed(trsf);
+        segments.emplace_back(float(p.X()), float(p.Y()), float(p.Z()));
+      }
+    }
+  };
+
+  // Edges shared by two faces are visited from both; the map keeps the first.
+  TopTools_MapOfShape seenEdges;
+  for (TopExp_Explorer faceIt(shape, TopAbs_FACE); faceIt.More();
+       faceIt.Next()) {
+    TopoDS_Face const &face = TopoDS::Face(faceIt.Current());
+    TopLoc_Location faceLoc;
+    Handle(Poly_Triangulation) faceTris = BRep_Tool::Triangulation(face, faceLoc);
+
+    for (TopExp_Explorer edgeIt(face, TopAbs_EDGE); edgeIt.More();
+         edgeIt.Next()) {
+      TopoDS_Edge const &edge = TopoDS::Edge(edgeIt.Current());
+      if (BRep_Tool::Degenerated(edge) || !seenEdges.Add(edge)) { continue; }
+
+      if (!faceTris.IsNull()) {
+        Handle(Poly_PolygonOnTriangulation) polygon =
+            BRep_Tool::PolygonOnTriangulation(edge, faceTris, faceLoc);
+        if (!polygon.IsNull()) {
+          addPolyline([&](Standard_Integer i) {
+            return faceTris->Node(polygon->Node(i));
+          }, polygon->NbNodes(), faceLoc.Transformation());
+          continue;
+        }
+      }
+      TopLoc_Location edgeLoc;
+      Handle(Poly_Polygon3D) polygon = BRep_Tool::Polygon3D(edge, edgeLoc);
+      if (!polygon.IsNull()) {
+        addPolyline([&](Standard_Integer i) { return polygon->Nodes()(i); },
+                    polygon->NbNodes(), edgeLoc.Transformation());
+      }
+    }
+  }
+  return segments;
+}
+
+Handle(Graphic3d_ArrayOfSegments) packEdges(std::vector<StaircasePart> &parts) {
+  Standard_Integer nbVertices = 0;
+  for (auto const &part : parts) {
+    nbVertices += static_cast<Standard_Integer>(part.edgeSegments.size());
+  }
+  if (nbVertices == 0) { return Handle(Graphic3d_ArrayOfSegments)(); }
+
+  // Mutable so hidden parts can collapse their edges without a re-upload of
+  // the whole array.
+  Handle(Graphic3d_ArrayOfSegments) segments = new Graphic3d_ArrayOfSegments(
+      nbVertices, 0, Graphic3d_ArrayFlags_AttribsMutable);
+  for (auto &part : parts) {
+    part.firstEdgeVertex = segments->VertexNumber() + 1;
+    part.nbEdgeVertices = static_cast<Standard_Integer>(part.edgeSegments.size());
+    for (Graphic3d_Vec3 const &vertex : part.edgeSegments) {
+      segments->AddVertex(vertex);
+    }
+    std::vector<Graphic3d_Vec3>().swap(part.edgeSegments);
+  }
+  return segments;
+}
+
+namespace {
+// Meshes `shape` unless its faces are fine enough already, and gives every
+// face triangulation normals, so that reading the meshes afterwards writes
+// nothing to the shape.
+void tessellate(TopoDS_Shape const &shape) {
+  // Same deflection settings as the default drawer of the AIS context, so
+  // AIS_Shape finds the triangulation up to date and does not mesh again.
+  // Tessellate stores the computed deflection in the drawer, so every call
+  // gets its own.
+  Handle(Prs3d_Drawer) drawer = new Prs3d_Drawer();
+  StdPrs_ToolTriangulatedShape::Tessellate(shape, drawer);
+  for (TopExp_Explorer it(shape, TopAbs_FACE); it.More(); it.Next()) {
+    TopoDS_Face const &face = TopoDS::Face(it.Current());
+    TopLoc_Location loc;
+    Handle(Poly_Triangulation) faceTris = BRep_Tool::Triangulation(face, loc);
+    if (!faceTris.IsNull() && !faceTris->HasNormals()) {
+      BRepLib_ToolTriangulatedShape::ComputeNormals(face, faceTris);
+    }
+  }
+}
+
+bool isClosedSolid(TopoDS_Shape const &shape) {
+  if (!TopExp_Explorer(shape, TopAbs_SOLID).More()) { return false; }
+  // Shells and faces outside solids bound nothing.
+  if (TopExp_Explorer(shape, TopAbs_SHELL, TopAbs_SOLID).More() ||
+      TopExp_Explorer(shape, TopAbs_FACE, TopAbs_SHELL).More()) {
+    return false;
+  }
+  for (TopExp_Explorer it(shape, TopAbs_SHELL); it.More(); it.Next()) {
+    if (!BRep_Tool::IsClosed(it.Current())) { return false; }
+  }
+  return true;
+}
+
+void prepareMeshes(StaircasePart &part) {
+  part.isClosed = isClosedSolid(part.shape);
+  part.mesh = mergeTriangulations(part.shape, &part.faceTriangleEnds);
+  part.edgeSegments = extractEdgeSegments(part.shape);
+  part.bounds = computeMeshBounds(part.mesh);
+
+  // Each level is simplified from the previous one, which is much cheaper
+  // than starting over from the full mesh.
+  Handle(Poly_Triangulation) previous = part.mesh;
+  double previousRatio = 1.0;
+  for (double ratio : LOD_RATIOS) {
+    Handle(Poly_Triangulation) lod =
+        decimateTriangulation(previous, ratio / previousRatio);
+    if (lod.IsNull()) { break; }
+    part.lods.push_back(lod);
+    previous = lod;
+    previousRatio = ratio;
+  }
+}
+} // namespace
+
+std::vector<StaircasePart> prepareParts(Handle(TDocStd_Document) const aDoc) {
+  std::vector<StaircasePart> parts;
+  for (auto const &[label, shape] : getLabeledShapesFromDoc(aDoc)) {
+    StaircasePart part;
+    part.shape = shape;
+    part.color = getShapeColor(aDoc, shape);
+    TDF_Tool::Entry(label, part.labelEntry);
+    parts.push_back(part);
+  }
+
+  // Assemblies and their components share faces, so parts cannot be meshed
+  // side by side. Distinct solids can, unless they share edges or vertices:
+  // BRepMesh stores the discretization of an edge on the edge itself. Solids
+  // sharing nothing are meshed on the task pool while the others are meshed
+  // here, one after another. Their bounds are smaller than those of the parts
+  // made of them, so the relative deflection is usually fine enough for those
+  // too.
+  TopTools_IndexedMapOfShape solids;
+  for (auto const &part : parts) {
+    for (TopExp_Explorer it(part.shape, TopAbs_SOLID); it.More(); it.Next()) {
+      solids.Add(it.Current().Located(TopLoc_Location()));
+    }
+  }
+  // Without locations, so instances placed differently count as the same.
+  TopTools_IndexedDataMapOfShapeListOfShape solidsOfSubShape;
+  for (Standard_Integer i = 1; i <= solids.Extent(); ++i) {
+    for (TopAbs_ShapeEnum type : {TopAbs_EDGE, TopAbs_VERTEX}) {
+      TopTools_MapOfShape seen;
+      for (TopExp_Explorer it(solids(i), type); it.More(); it.Next()) {
+        TopoDS_Shape const subShape = it.Current().Located(TopLoc_Location());
+        if (!seen.Add(subShape)) { continue; }
+        Standard_Integer index = solidsOfSubShape.FindIndex(subShape);
+        if (index == 0) {
+          index = solidsOfSubShape.Add(subShape, TopTools_ListOfShape());
+        }
+        solidsOfSubShape(index).Append(solids(i));
+      }
+    }
+  }
+  TopTools_MapOfShape sharingSolids;
+  for (Standard_Integer i = 1; i <= solidsOfSubShape.Extent(); ++i) {
+    TopTools_ListOfShape const &owners = solidsOfSubShape(i);
+    if (owners.Extent() < 2) { continue; }
+    for (TopoDS_Shape const &solid : owners) { sharingSolids.Add(solid); }
+  }
+
+  TaskPool &pool = TaskPool::instance();
+  std::vector<std::future<void>> tasks;
+  for (Standard_Integer i = 1; i <= solids.Extent(); ++i) {
+    if (sharingSolids.Contains(solids(i))) { continue; }
+    tasks.push_back(pool.submit([solid = solids(i)] { tessellate(solid); }));
+  }
+  for (Standard_Integer i = 1; i <= solids.Extent(); ++i) {
+    if (sharingSolids.Contains(solids(i))) { tessellate(solids(i)); }
+  }
+  for (auto &task : tasks) { task.get(); }
+  tasks.clear();
+
+  // Left for shells and faces outside solids; a quick check for the rest.
+  for (auto const &part : parts) { tessellate(part.shape); }
+
+  // Shapes are only read from here on.
+  for (auto &part : parts) {
+    tasks.push_back(pool.submit([&part] { prepareMeshes(part); }));
+  }
+  for (auto &task : tasks) { task.get(); }
+
+  clusterParts(parts, MAX_PARTS_PER_CLUSTER);
+  return parts;
+}
+
+StaircaseNodeParts mapNodeParts(Handle(TDocStd_Document) const aDoc,
+                                std::vector<StaircasePart> const &parts) {
+  Handle(XCAFDoc_ShapeTool) shapeTool =
+      XCAFDoc_DocumentTool::ShapeTool(aDoc->Main());
+  std::map<std::string, size_t> partOfEntry;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    partOfEntry.emplace(parts[i].labelEntry, i);
+  }
+
+  // Shapes referenced by several components are visited once.
+  StaircaseNodeParts nodeParts;
+  std::function<std::vector<size_t> const &(TDF_Label const &)> visit =
+      [&](TDF_Label const &label) -> std::vector<size_t> const & {
+    std::string entry;
+    TDF_Tool::Entry(label, entry);
+    auto const visited = nodeParts.find(entry);
+    if (visited != nodeParts.end()) { return visited->second; }
+
+    std::vector<size_t> indices;
+    auto const part = partOfEntry.find(entry);
+    if (part != partOfEntry.end()) { indices.push_back(part->second); }
+    TDF_Label referred;
+    if (XCAFDoc_ShapeTool::IsReference(label) &&
+        XCAFDoc_ShapeTool::GetReferredShape(label, referred)) {
+      std::vector<size_t> const &below = visit(referred);
+      indices.insert(indices.end(), below.begin(), below.end());
+    }
+    if (XCAFDoc_ShapeTool::IsAssembly(label)) {
+      TDF_LabelSequence components;
+      XCAFDoc_ShapeTool::GetComponents(label, components);
+      for (TDF_Label const &component : components) {
+        std::vector<size_t> const &below = visit(component);
+        indices.insert(indices.end(), below.begin(), below.end());
+      }
+    }
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    return nodeParts[entry] = std::move(indices);
+  };
+
+  TDF_LabelSequence freeShapes;
+  shapeTool->GetFreeShapes(freeShapes);
+  for (TDF_Label const &label : freeShapes) { visit(label); }
+  // Parts no free shape leads to still get a node of their own.
+  for (auto const &part : parts) {
+    TDF_Label label;
+    TDF_Tool::Label(aDoc->GetData(), part.labelEntry.c_str(), label);
+    if (!label.IsNull()) { visit(label); }
+  }
+  return nodeParts;
+}
+
+void clusterParts(std::vector<StaircasePart> &parts, size_t maxPartsPerCluster) {
+  std::vector<size_t> order(parts.size());
+  std::vector<gp_XYZ> centers(parts.size());
+  for (size_t i = 0; i < parts.size(); ++i) {
+    order[i] = i;
+    if (!parts[i].bounds.IsVoid()) {
+      centers[i] = (parts[i].bounds.CornerMin().XYZ() +
+                    parts[i].bounds.CornerMax().XYZ()) * 0.5;
+    }
+  }
+
+  // Median split along the longest axis of the part centers until every
+  // node is small enough; each leaf becomes a cluster.
+  int nextCluster = 0;
+  std::function<void(size_t, size_t)> split = [&](size_t first, size_t last) {
+    if (last - first <= maxPartsPerCluster) {
+      for (size_t i = first; i < last; ++i) {
+        parts[order[i]].cluster = nextCluster;
+      }
+      ++nextCluster;
+      return;
+    }
+
+    Bnd_Box centerBounds;
+    for (size_t i = first; i < last; ++i) {
+      centerBounds.Add(gp_Pnt(centers[order[i]]));
+    }
+    gp_XYZ const size =
+        centerBounds.CornerMax().XYZ() - centerBounds.CornerMin().XYZ();
+    int const axis = size.X() >= size.Y() && size.X() >= size.Z() ? 1
+                     : size.Y() >= size.Z()                     ? 2
+                                                                : 3;
+
+    size_t const middle = first + (last - first) / 2;
+    std::nth_element(order.begin() + first, order.begin() + middle,
+                     order.begin() + last, [&](size_t a, size_t b) {
+                       return centers[a].Coord(axis) < centers[b].Coord(axis);
+                     });
+    split(first, middle);
+    split(middle, last);
+  };
+  split(0, parts.size());
+}
+
+void releaseDocument(Handle(XCAFApp_Application) app,
+                     Handle(TDocStd_Document) &aDoc,
+                     std::vector<StaircasePart> &parts) {
+  for (auto &part : parts) {
+    part.shape.Nullify();
+  }
+  if (!aDoc.IsNull()) {
+    app->Close(aDoc);
+    aDoc.Nullify();
+  }
+}
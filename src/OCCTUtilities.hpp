@@ -1,7 +1,10 @@
 #ifndef OCCTUTILITIES_HPP
 #define OCCTUTILITIES_HPP
+#include "StaircasePart.hpp"
 #include "ViewerContext.hpp"
 #include "staircase.hpp"
+#include <opencascade/Graphic3d_ArrayOfSegments.hxx>
+#include <opencascade/Graphic3d_ArrayOfTriangles.hxx>
 
 std::optional<Handle(TDocStd_Document)>
 readInto(std::function<Handle(TDocStd_Document)()> aNewDoc,
@@ -19,7 +22,74 @@ void readStepFile(
     Handle(XCAFApp_Application) app, std::string stepFileStr,
     std::function<void(std::optional<Handle(TDocStd_Document)>)> callback);
 
-std::vector<TopoDS_Shape> getShapesFromDoc(Handle(TDocStd_Document) const aDoc);
+std::vector<std::pair<TDF_Label, TopoDS_Shape>>
+getLabeledShapesFromDoc(Handle(TDocStd_Document) const aDoc);
 std::optional<Quantity_Color> getShapeColor(Handle(TDocStd_Document) const aDoc,
                                             TopoDS_Shape const shape);
+
+/**
+ * Merges the triangulations of all faces of a shape into a single one, with
+ * face locations applied and vertex normals filled in.
+ *
+ * @param faceTriangleEnds If set, receives the end of each face's triangle
+ *        range in the merged triangulation.
+ * @return A null handle when the shape has no triangulated faces.
+ */
+Handle(Poly_Triangulation)
+    mergeTriangulations(TopoDS_Shape const &shape,
+                        std::vector<Standard_Integer> *faceTriangleEnds = nullptr);
+
+/**
+ * Copies a triangulation with normals into a shaded primitive array.
+ *
+ * @param theFlags Extra Graphic3d_ArrayFlags, e.g. to make indices mutable.
+ * @return A null handle when the triangulation is missing or has no normals.
+ */
+Handle(Graphic3d_ArrayOfTriangles)
+    createTriangleArray(Handle(Poly_Triangulation) const &triangulation,
+                        Graphic3d_ArrayFlags theFlags = Graphic3d_ArrayFlags_None);
+
+/**
+ * Tessellates every shape of the document and builds its merged mesh and
+ * navigation proxies. Meant to run on the background worker.
+ */
+std::vector<StaircasePart> prepareParts(Handle(TDocStd_Document) const aDoc);
+
+/**
+ * Maps every node of the document's assembly structure to the parts below
+ * it, following components to the shapes they reference. Needs the
+ * document, so it runs on the background worker before a release.
+ */
+StaircaseNodeParts mapNodeParts(Handle(TDocStd_Document) const aDoc,
+                                std::vector<StaircasePart> const &parts);
+
+/**
+ * Groups parts that lie close together: every part gets the index of a leaf
+ * of a median-split hierarchy over the part bounds, with at most
+ * `maxPartsPerCluster` parts per leaf.
+ */
+void clusterParts(std::vector<StaircasePart> &parts, size_t maxPartsPerCluster);
+
+/**
+ * Discretizes the face boundaries of a tessellated shape into line segment
+ * endpoints, reusing the polygons the mesher stored on each triangulation.
+ * Every edge is emitted once, even when shared by several faces.
+ */
+std::vector<Graphic3d_Vec3> extractEdgeSegments(TopoDS_Shape const &shape);
+
+/**
+ * Moves the edge segments of all parts into one segment array and records
+ * each part's vertex range in it.
+ *
+ * @return A null handle when no part has edges.
+ */
+Handle(Graphic3d_ArrayOfSegments) packEdges(std::vector<StaircasePart> &parts);
+
+/**
+ * Drops the BRep of every part and closes the document, leaving the parts
+ * with only their meshes, colors and metadata.
+ */
+void releaseDocument(Handle(XCAFApp_Application) app,
+                     Handle(TDocStd_Document) &aDoc,
+                     std::vector<StaircasePart> &parts);
 #endif
@@ -0,0 +1,215 @@
+#include "OcclusionCuller.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+namespace {
+// Points closer to the camera plane than this, in clip space w, cannot be
+// projected reliably.
+float const MIN_CLIP_W = 1e-5f;
+
+// How much nearer, in NDC depth, an occluder has to be than a box to hide
+// it. Occluders may be simplified meshes that bulge past the real surface.
+float const OCCLUSION_DEPTH_BIAS = 1e-3f;
+} // namespace
+
+void OcclusionCuller::begin(Graphic3d_Mat4 const &theViewProjection,
+                            int viewWidth, int viewHeight) {
+  viewProjection = theViewProjection;
+  width = WIDTH;
+  height = viewWidth > 0
+               ? std::max(4, int(float(WIDTH) * viewHeight / viewWidth + 0.5f))
+               : WIDTH;
+  depth.assign(size_t(width) * height, std::numeric_limits<float>::infinity());
+}
+
+Graphic3d_Vec3 OcclusionCuller::toScreen(Graphic3d_Vec4 const &clip) const {
+  float const invW = 1.0f / clip.w();
+  return Graphic3d_Vec3((clip.x() * invW * 0.5f + 0.5f) * width,
+                        (clip.y() * invW * 0.5f + 0.5f) * height,
+                        clip.z() * invW);
+}
+
+void OcclusionCuller::addOccluder(Handle(Poly_Triangulation) const &mesh) {
+  if (mesh.IsNull()) { return; }
+
+  std::vector<Graphic3d_Vec4> clipNodes(mesh->NbNodes());
+  for (Standard_Integer i = 1; i <= mesh->NbNodes(); ++i) {
+    gp_Pnt const node = mesh->Node(i);
+    clipNodes[i - 1] = viewProjection * Graphic3d_Vec4(float(node.X()),
+                                                       float(node.Y()),
+                                                       float(node.Z()), 1.0f);
+  }
+
+  for (Standard_Integer i = 1; i <= mesh->NbTriangles(); ++i) {
+    Standard_Integer n1, n2, n3;
+    mesh->Triangle(i).Get(n1, n2, n3);
+    Graphic3d_Vec4 const &c1 = clipNodes[n1 - 1];
+    Graphic3d_Vec4 const &c2 = clipNodes[n2 - 1];
+    Graphic3d_Vec4 const &c3 = clipNodes[n3 - 1];
+
+    // Leaving out a triangle only makes the buffer less occluding, so there
+    // is no need to clip against the camera plane.
+    if (c1.w() < MIN_CLIP_W || c2.w() < MIN_CLIP_W || c3.w() < MIN_CLIP_W) {
+      continue;
+    }
+    rasterizeTriangle(toScreen(c1), toScreen(c2), toScreen(c3));
+  }
+}
+
+void OcclusionCuller::rasterizeTriangle(Graphic3d_Vec3 const &v0,
+                                        Graphic3d_Vec3 const &theV1,
+                                        Graphic3d_Vec3 const &theV2) {
+  Graphic3d_Vec3 v1 = theV1;
+  Graphic3d_Vec3 v2 = theV2;
+  float area = (v1.x() - v0.x()) * (v2.y() - v0.y()) -
+               (v1.y() - v0.y()) * (v2.x() - v0.x());
+  if (std::abs(area) < 1e-8f) { return; }
+  if (area < 0.0f) {
+    std::swap(v1, v2);
+    area = -area;
+  }
+
+  int const minX = std::max(
+      0, int(std::floor(std::min({v0.x(), v1.x(), v2.x()}))));
+  int const maxX = std::min(
+      width - 1, int(std::floor(std::max({v0.x(), v1.x(), v2.x()}))));
+  int const minY = std::max(
+      0, int(std::floor(std::min({v0.y(), v1.y(), v2.y()}))));
+  int const maxY = std::min(
+      height - 1, int(std::floor(std::max({v0.y(), v1.y(), v2.y()}))));
+  if (minX > maxX || minY > maxY) { return; }
+
+  // Edge functions e(p) = a * x + b * y + c, positive inside. The one of the
+  // edge opposite a vertex, divided by the area, is that vertex's weight.
+  auto edge = [](Graphic3d_Vec3 const &from, Graphic3d_Vec3 const &to) {
+    float const a = from.y() - to.y();
+    float const b = to.x() - from.x();
+    return Graphic3d_Vec3(a, b, -(a * from.x() + b * from.y()));
+  };
+  Graphic3d_Vec3 const e12 = edge(v1, v2);
+  Graphic3d_Vec3 const e20 = edge(v2, v0);
+  Graphic3d_Vec3 const e01 = edge(v0, v1);
+  Graphic3d_Vec3 const zPlane =
+      (e12 * v0.z() + e20 * v1.z() + e01 * v2.z()) / area;
+
+#ifdef __wasm_simd128__
+  v128_t const laneOffsets = wasm_f32x4_make(0.5f, 1.5f, 2.5f, 3.5f);
+  v128_t const zero = wasm_f32x4_splat(0.0f);
+  v128_t const a12 = wasm_f32x4_splat(e12.x());
+  v128_t const a20 = wasm_f32x4_splat(e20.x());
+  v128_t const a01 = wasm_f32x4_splat(e01.x());
+  v128_t const aZ = wasm_f32x4_splat(zPlane.x());
+#endif
+
+  for (int y = minY; y <= maxY; ++y) {
+    float const py = float(y) + 0.5f;
+    float const row12 = e12.y() * py + e12.z();
+    float const row20 = e20.y() * py + e20.z();
+    float const row01 = e01.y() * py + e01.z();
+    float const rowZ = zPlane.y() * py + zPlane.z();
+    float *const depthRow = depth.data() + size_t(y) * width;
+
+#ifdef __wasm_simd128__
+    // WIDTH is a multiple of 4, so aligned blocks never leave the row.
+    for (int x = minX & ~3; x <= maxX; x += 4) {
+      v128_t const px =
+          wasm_f32x4_add(wasm_f32x4_splat(float(x)), laneOffsets);
+      v128_t const w12 =
+          wasm_f32x4_add(wasm_f32x4_mul(a12, px), wasm_f32x4_splat(row12));
+      v128_t const w20 =
+          wasm_f32x4_add(wasm_f32x4_mul(a20, px), wasm_f32x4_splat(row20));
+      v128_t const w01 =
+          wasm_f32x4_add(wasm_f32x4_mul(a01, px), wasm_f32x4_splat(row01));
+      v128_t const inside =
+          wasm_v128_and(wasm_v128_and(wasm_f32x4_ge(w12, zero),
+                                      wasm_f32x4_ge(w20, zero)),
+                        wasm_f32x4_ge(w01, zero));
+      if (!wasm_v128_any_true(inside)) { continue; }
+
+      v128_t const z =
+          wasm_f32x4_add(wasm_f32x4_mul(aZ, px), wasm_f32x4_splat(rowZ));
+      v128_t const current = wasm_v128_load(depthRow + x);
+      v128_t const nearest = wasm_f32x4_min(current, z);
+      wasm_v128_store(depthRow + x,
+                      wasm_v128_bitselect(nearest, current, inside));
+    }
+#else
+    for (int x = minX; x <= maxX; ++x) {
+      float const px = float(x) + 0.5f;
+      if (e12.x() * px + row12 < 0.0f || e20.x() * px + row20 < 0.0f ||
+          e01.x() * px + row01 < 0.0f) {
+        continue;
+      }
+      float const z = zPlane.x() * px + rowZ;
+      depthRow[x] = std::min(depthRow[x], z);
+    }
+#endif
+  }
+}
+
+bool OcclusionCuller::isOccluded(Bnd_Box const &bounds) const {
+  if (bounds.IsVoid() || depth.empty()) { return false; }
+
+  gp_Pnt const lo = bounds.CornerMin();
+  gp_Pnt const hi = bounds.CornerMax();
+  float minX = std::numeric_limits<float>::max();
+  float minY = std::numeric_limits<float>::max();
+  float maxX = std::numeric_limits<float>::lowest();
+  float maxY = std::numeric_limits<float>::lowest();
+  float minZ = std::numeric_limits<float>::max();
+  for (int corner = 0; corner < 8; ++corner) {
+    Graphic3d_Vec4 const clip =
+        viewProjection *
+        Graphic3d_Vec4(float(corner & 1 ? hi.X() : lo.X()),
+                       float(corner & 2 ? hi.Y() : lo.Y()),
+                       float(corner & 4 ? hi.Z() : lo.Z()), 1.0f);
+    if (clip.w() < MIN_CLIP_W) { return false; }
+
+    Graphic3d_Vec3 const screen = toScreen(clip);
+    minX = std::min(minX, screen.x());
+    maxX = std::max(maxX, screen.x());
+    minY = std::min(minY, screen.y());
+    maxY = std::max(maxY, screen.y());
+    minZ = std::min(minZ, screen.z());
+  }
+  // In front of the near plane or outside the view: left to the renderer.
+  if (minZ < -1.0f || maxX < 0.0f || maxY < 0.0f || minX >= float(width) ||
+      minY >= float(height)) {
+    return false;
+  }
+
+  // Occluders only cover the pixels whose centers they contain, so the box is
+  // widened by a pixel on every side: a part of it in a pixel only partly
+  // covered still has to be hidden by a neighbor.
+  int const x0 = std::max(0, int(std::floor(minX)) - 1);
+  int const x1 = std::min(width - 1, int(std::floor(maxX)) + 1);
+  int const y0 = std::max(0, int(std::floor(minY)) - 1);
+  int const y1 = std::min(height - 1, int(std::floor(maxY)) + 1);
+  float const boxDepth = minZ - OCCLUSION_DEPTH_BIAS;
+
+#ifdef __wasm_simd128__
+  v128_t const boxDepth4 = wasm_f32x4_splat(boxDepth);
+#endif
+  for (int y = y0; y <= y1; ++y) {
+    float const *const depthRow = depth.data() + size_t(y) * width;
+#ifdef __wasm_simd128__
+    // Widening the span to whole blocks only tests more pixels, which can
+    // make a box visible but never hides one wrongly.
+    for (int x = x0 & ~3; x <= x1; x += 4) {
+      v128_t const notNearer =
+          wasm_f32x4_ge(wasm_v128_load(depthRow + x), boxDepth4);
+      if (wasm_v128_any_true(notNearer)) { return false; }
+    }
+#else
+    for (int x = x0; x <= x1; ++x) {
+      if (depthRow[x] >= boxDepth) { return false; }
+    }
+#endif
+  }
+  return true;
+}
@@ -0,0 +1,42 @@
+#ifndef OCCLUSIONCULLER_HPP
+#define OCCLUSIONCULLER_HPP
+#include <opencascade/Bnd_Box.hxx>
+#include <opencascade/Graphic3d_Mat4.hxx>
+#include <opencascade/Graphic3d_Vec3.hxx>
+#include <opencascade/Graphic3d_Vec4.hxx>
+#include <opencascade/Poly_Triangulation.hxx>
+#include <vector>
+
+/**
+ * Software occlusion culling on a small depth buffer, for WebGL 1 where
+ * occlusion queries are not available.
+ *
+ * Each frame the largest occluders are rasterized into the buffer, then the
+ * bounding boxes of the other objects are tested against it. A box counts as
+ * occluded only when every pixel it touches and the ring of pixels around
+ * them are nearer by a depth bias, and anything that crosses the camera
+ * plane counts as visible. Errors therefore lean towards drawing. The inner loops run four pixels at a time with WebAssembly SIMD
+ * when the build enables it.
+ */
+class OcclusionCuller {
+public:
+  // Buffer width in pixels; the height follows the aspect ratio of the view.
+  static int const WIDTH = 256;
+
+  void begin(Graphic3d_Mat4 const &viewProjection, int viewWidth,
+             int viewHeight);
+  void addOccluder(Handle(Poly_Triangulation) const &mesh);
+  bool isOccluded(Bnd_Box const &bounds) const;
+
+private:
+  Graphic3d_Mat4 viewProjection;
+  int width = 0;
+  int height = 0;
+  std::vector<float> depth; // NDC depth, nearest occluder per pixel
+
+  // Screen x, screen y and NDC depth of a clip space point.
+  Graphic3d_Vec3 toScreen(Graphic3d_Vec4 const &clip) const;
+  void rasterizeTriangle(Graphic3d_Vec3 const &v0, Graphic3d_Vec3 const &v1,
+                         Graphic3d_Vec3 const &v2);
+};
+#endif // OCCLUSIONCULLER_HPP
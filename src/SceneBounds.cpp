@@ -0,0 +1,159 @@
+#include "SceneBounds.hpp"
+#include <algorithm>
+#include <limits>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+namespace {
+double const EMPTY_MIN = std::numeric_limits<double>::max();
+double const EMPTY_MAX = std::numeric_limits<double>::lowest();
+
+// Poly_ArrayOfNodes hides the typed accessors of its base.
+template <typename T> T const *nodeData(Poly_ArrayOfNodes const &nodes) {
+  return &static_cast<NCollection_AliasedArray<> const &>(nodes).Value<T>(0);
+}
+
+void doubleNodeBounds(gp_Pnt const *nodes, int nbNodes, double *lo,
+                      double *hi) {
+#ifdef __wasm_simd128__
+  // x and y in one register, z on its own.
+  double const *first = nodes[0].XYZ().GetData();
+  v128_t minXY = wasm_v128_load(first);
+  v128_t maxXY = minXY;
+  double minZ = first[2];
+  double maxZ = first[2];
+  for (int i = 1; i < nbNodes; ++i) {
+    double const *p = nodes[i].XYZ().GetData();
+    v128_t const xy = wasm_v128_load(p);
+    minXY = wasm_f64x2_pmin(minXY, xy);
+    maxXY = wasm_f64x2_pmax(maxXY, xy);
+    minZ = std::min(minZ, p[2]);
+    maxZ = std::max(maxZ, p[2]);
+  }
+  lo[0] = wasm_f64x2_extract_lane(minXY, 0);
+  lo[1] = wasm_f64x2_extract_lane(minXY, 1);
+  lo[2] = minZ;
+  hi[0] = wasm_f64x2_extract_lane(maxXY, 0);
+  hi[1] = wasm_f64x2_extract_lane(maxXY, 1);
+  hi[2] = maxZ;
+#else
+  for (int c = 0; c < 3; ++c) {
+    lo[c] = hi[c] = nodes[0].Coord(c + 1);
+  }
+  for (int i = 1; i < nbNodes; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      double const v = nodes[i].Coord(c + 1);
+      lo[c] = std::min(lo[c], v);
+      hi[c] = std::max(hi[c], v);
+    }
+  }
+#endif
+}
+
+void floatNodeBounds(gp_Vec3f const *nodes, int nbNodes, double *lo,
+                     double *hi) {
+#ifdef __wasm_simd128__
+  // Loads four floats per node; the fourth lane, which belongs to the next
+  // node, is ignored. The last node is read on its own so the loads never
+  // leave the array.
+  v128_t minV = wasm_f32x4_make(nodes[0].x(), nodes[0].y(), nodes[0].z(), 0.f);
+  v128_t maxV = minV;
+  for (int i = 1; i + 1 < nbNodes; ++i) {
+    v128_t const v = wasm_v128_load(nodes[i].GetData());
+    minV = wasm_f32x4_pmin(minV, v);
+    maxV = wasm_f32x4_pmax(maxV, v);
+  }
+  if (nbNodes > 1) {
+    gp_Vec3f const &last = nodes[nbNodes - 1];
+    v128_t const v = wasm_f32x4_make(last.x(), last.y(), last.z(), 0.f);
+    minV = wasm_f32x4_pmin(minV, v);
+    maxV = wasm_f32x4_pmax(maxV, v);
+  }
+  lo[0] = wasm_f32x4_extract_lane(minV, 0);
+  lo[1] = wasm_f32x4_extract_lane(minV, 1);
+  lo[2] = wasm_f32x4_extract_lane(minV, 2);
+  hi[0] = wasm_f32x4_extract_lane(maxV, 0);
+  hi[1] = wasm_f32x4_extract_lane(maxV, 1);
+  hi[2] = wasm_f32x4_extract_lane(maxV, 2);
+#else
+  for (int c = 0; c < 3; ++c) {
+    lo[c] = hi[c] = nodes[0][c];
+  }
+  for (int i = 1; i < nbNodes; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      lo[c] = std::min(lo[c], double(nodes[i][c]));
+      hi[c] = std::max(hi[c], double(nodes[i][c]));
+    }
+  }
+#endif
+}
+} // namespace
+
+Bnd_Box computeMeshBounds(Handle(Poly_Triangulation) const &mesh) {
+  Bnd_Box bounds;
+  if (mesh.IsNull() || mesh->NbNodes() == 0) { return bounds; }
+
+  Poly_ArrayOfNodes const &nodes = mesh->InternalNodes();
+  double lo[3], hi[3];
+  if (nodes.IsDoublePrecision()) {
+    doubleNodeBounds(nodeData<gp_Pnt>(nodes), nodes.Length(), lo, hi);
+  } else {
+    floatNodeBounds(nodeData<gp_Vec3f>(nodes), nodes.Length(), lo, hi);
+  }
+  bounds.Update(lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+  return bounds;
+}
+
+void SceneBounds::reset(std::vector<StaircasePart> const &parts) {
+  partBounds.clear();
+  partBounds.reserve(parts.size());
+  for (auto const &part : parts) {
+    partBounds.push_back(part.bounds);
+  }
+
+  nbLeaves = 1;
+  while (nbLeaves < parts.size()) {
+    nbLeaves *= 2;
+  }
+  mins.assign(2 * nbLeaves, Graphic3d_Vec3d(EMPTY_MIN));
+  maxs.assign(2 * nbLeaves, Graphic3d_Vec3d(EMPTY_MAX));
+}
+
+void SceneBounds::clear() {
+  partBounds.clear();
+  nbLeaves = 0;
+  mins.clear();
+  maxs.clear();
+}
+
+void SceneBounds::setPartShown(size_t partIndex, bool isShown) {
+  if (partIndex >= partBounds.size()) { return; }
+
+  size_t node = nbLeaves + partIndex;
+  Bnd_Box const &box = partBounds[partIndex];
+  if (isShown && !box.IsVoid()) {
+    gp_Pnt const lo = box.CornerMin();
+    gp_Pnt const hi = box.CornerMax();
+    mins[node] = Graphic3d_Vec3d(lo.X(), lo.Y(), lo.Z());
+    maxs[node] = Graphic3d_Vec3d(hi.X(), hi.Y(), hi.Z());
+  } else {
+    mins[node] = Graphic3d_Vec3d(EMPTY_MIN);
+    maxs[node] = Graphic3d_Vec3d(EMPTY_MAX);
+  }
+
+  for (node /= 2; node >= 1; node /= 2) {
+    mins[node] = mins[2 * node].cwiseMin(mins[2 * node + 1]);
+    maxs[node] = maxs[2 * node].cwiseMax(maxs[2 * node + 1]);
+  }
+}
+
+Bnd_Box SceneBounds::get() const {
+  Bnd_Box bounds;
+  if (mins.size() < 2 || mins[1].x() > maxs[1].x()) { return bounds; }
+
+  bounds.Update(mins[1].x(), mins[1].y(), mins[1].z(), maxs[1].x(),
+                maxs[1].y(), maxs[1].z());
+  return bounds;
+}
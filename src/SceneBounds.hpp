@@ -0,0 +1,40 @@
+#ifndef SCENEBOUNDS_HPP
+#define SCENEBOUNDS_HPP
+#include "StaircasePart.hpp"
+#include <opencascade/Bnd_Box.hxx>
+#include <opencascade/Graphic3d_Vec3.hxx>
+#include <opencascade/Poly_Triangulation.hxx>
+#include <vector>
+
+/**
+ * Axis-aligned bounds of the nodes of a triangulation, computed several
+ * coordinates at a time with WebAssembly SIMD when the build enables it.
+ */
+Bnd_Box computeMeshBounds(Handle(Poly_Triangulation) const &mesh);
+
+/**
+ * Bounds of the parts currently shown, kept up to date as parts are shown and
+ * hidden so fitting the view never has to visit every presentation.
+ *
+ * The part boxes sit in the leaves of a segment tree whose inner nodes hold
+ * the union of their children. Showing or hiding a part refreshes one path to
+ * the root, and the scene bounds are read from the root.
+ */
+class SceneBounds {
+public:
+  // Takes the bounds of every part, all of them hidden.
+  void reset(std::vector<StaircasePart> const &parts);
+  void clear();
+
+  void setPartShown(size_t partIndex, bool isShown);
+  Bnd_Box get() const;
+
+private:
+  std::vector<Bnd_Box> partBounds;
+  size_t nbLeaves = 0;
+
+  // Heap order with the root at 1. An empty node has min > max.
+  std::vector<Graphic3d_Vec3d> mins;
+  std::vector<Graphic3d_Vec3d> maxs;
+};
+#endif // SCENEBOUNDS_HPP
@@ -0,0 +1,193 @@
+#include "StaircaseBatch.hpp"
+#include "OCCTUtilities.hpp"
+#include <opencascade/Graphic3d_MutableIndexBuffer.hxx>
+#include <opencascade/Prs3d_ShadingAspect.hxx>
+#include <opencascade/Select3D_SensitiveTriangulation.hxx>
+#include <opencascade/SelectMgr_Selection.hxx>
+
+StaircaseBatch::StaircaseBatch(std::optional<Quantity_Color> const &color,
+                               std::vector<StaircasePart> const &parts,
+                               std::vector<size_t> const &partIndices) {
+  Standard_Integer nbVertices = 0;
+  Standard_Integer nbEdges = 0;
+  for (size_t partIndex : partIndices) {
+    Handle(Poly_Triangulation) const &mesh = parts[partIndex].mesh;
+    if (mesh.IsNull() || !mesh->HasNormals()) { continue; }
+    nbVertices += mesh->NbNodes();
+    nbEdges += mesh->NbTriangles() * 3;
+  }
+
+  triangles = new Graphic3d_ArrayOfTriangles(
+      nbVertices, nbEdges,
+      Graphic3d_ArrayFlags_VertexNormal | Graphic3d_ArrayFlags_IndexesMutable);
+
+  for (size_t partIndex : partIndices) {
+    Handle(Poly_Triangulation) const &mesh = parts[partIndex].mesh;
+    if (mesh.IsNull() || !mesh->HasNormals()) { continue; }
+
+    PartRange range;
+    range.partIndex = partIndex;
+    range.mesh = mesh;
+    range.firstVertex = triangles->VertexNumber() + 1;
+    range.firstEdge = triangles->EdgeNumber() + 1;
+
+    for (Standard_Integer i = 1; i <= mesh->NbNodes(); ++i) {
+      triangles->AddVertex(mesh->Node(i), mesh->Normal(i));
+    }
+    Standard_Integer const offset = range.firstVertex - 1;
+    for (Standard_Integer i = 1; i <= mesh->NbTriangles(); ++i) {
+      Standard_Integer n1, n2, n3;
+      mesh->Triangle(i).Get(n1, n2, n3);
+      triangles->AddEdges(offset + n1, offset + n2, offset + n3);
+    }
+
+    rangeOfPart[partIndex] = ranges.size();
+    ranges.push_back(range);
+    isClosed = isClosed && parts[partIndex].isClosed;
+  }
+
+  if (color.has_value()) {
+    myDrawer->SetupOwnShadingAspect();
+    myDrawer->ShadingAspect()->SetColor(color.value());
+  }
+}
+
+bool StaircaseBatch::setPartVisible(size_t partIndex, bool visible) {
+  auto it = rangeOfPart.find(partIndex);
+  if (it == rangeOfPart.end()) { return false; }
+
+  PartRange &range = ranges[it->second];
+  if (range.visible == visible) { return true; }
+  range.visible = visible;
+
+  // Hidden parts keep their slice, collapsed onto a single vertex, so no
+  // other range has to move.
+  Standard_Integer const offset = range.firstVertex - 1;
+  Standard_Integer edge = range.firstEdge;
+  for (Standard_Integer i = 1; i <= range.mesh->NbTriangles(); ++i) {
+    Standard_Integer n[3];
+    range.mesh->Triangle(i).Get(n[0], n[1], n[2]);
+    for (int k = 0; k < 3; ++k) {
+      triangles->SetEdge(edge++, visible ? offset + n[k] : range.firstVertex);
+    }
+  }
+
+  Handle(Graphic3d_MutableIndexBuffer) indices =
+      Handle(Graphic3d_MutableIndexBuffer)::DownCast(triangles->Indices());
+  if (!indices.IsNull()) {
+    indices->Invalidate(range.firstEdge - 1, edge - 2);
+  }
+  return true;
+}
+
+bool StaircaseBatch::isPartVisible(size_t partIndex) const {
+  auto it = rangeOfPart.find(partIndex);
+  return it != rangeOfPart.end() && ranges[it->second].visible;
+}
+
+void StaircaseBatch::Compute(Handle(PrsMgr_PresentationManager) const &,
+                             Handle(Prs3d_Presentation) const &thePrs,
+                             Standard_Integer const theMode) {
+  if (theMode != 0 || ranges.empty()) { return; }
+
+  Handle(Graphic3d_Group) group = thePrs->NewGroup();
+  group->SetClosed(isClosed);
+  group->SetGroupPrimitivesAspect(myDrawer->ShadingAspect()->Aspect());
+  group->AddPrimitiveArray(triangles);
+}
+
+void StaircaseBatch::ComputeSelection(Handle(SelectMgr_Selection) const &theSel,
+                                      Standard_Integer const theMode) {
+  if (theMode != 0) { return; }
+
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    Handle(StaircaseBatchOwner) owner = new StaircaseBatchOwner(this, i);
+    theSel->Add(new Select3D_SensitiveTriangulation(owner, ranges[i].mesh,
+                                                    TopLoc_Location()));
+  }
+}
+
+StaircaseBatchOwner::StaircaseBatchOwner(Handle(StaircaseBatch) const &batch,
+                                         size_t rangeIndex)
+    : SelectMgr_EntityOwner(batch), rangeIndex(rangeIndex) {}
+
+StaircaseBatch const &StaircaseBatchOwner::getBatch() const {
+  return static_cast<StaircaseBatch const &>(*Selectable());
+}
+
+size_t StaircaseBatchOwner::getPartIndex() const {
+  return getBatch().getRanges()[rangeIndex].partIndex;
+}
+
+bool StaircaseBatchOwner::isPartVisible() const {
+  return getBatch().getRanges()[rangeIndex].visible;
+}
+
+Standard_Boolean
+StaircaseBatchOwner::IsHilighted(Handle(PrsMgr_PresentationManager) const &,
+                                 Standard_Integer const) const {
+  return !selectionPrs.IsNull() && selectionPrs->IsDisplayed();
+}
+
+void StaircaseBatchOwner::HilightWithColor(
+    Handle(PrsMgr_PresentationManager) const &thePM,
+    Handle(Prs3d_Drawer) const &theStyle, Standard_Integer const) {
+  bool const isImmediate = thePM->IsImmediateModeOn();
+  Handle(Prs3d_Presentation) prs;
+  if (isImmediate) {
+    prs = Selectable()->GetHilightPresentation(thePM);
+  } else {
+    if (selectionPrs.IsNull()) {
+      selectionPrs = new Prs3d_Presentation(thePM->StructureManager());
+    }
+    prs = selectionPrs;
+  }
+
+  Graphic3d_ZLayerId const zLayer =
+      theStyle->ZLayer() != Graphic3d_ZLayerId_UNKNOWN ? theStyle->ZLayer()
+      : isImmediate                                    ? Graphic3d_ZLayerId_Top
+                                                       : Selectable()->ZLayer();
+  prs->Clear();
+  if (prs->GetZLayer() != zLayer) { prs->SetZLayer(zLayer); }
+
+  Handle(Graphic3d_ArrayOfTriangles) partTriangles =
+      createTriangleArray(getBatch().getRanges()[rangeIndex].mesh);
+  if (partTriangles.IsNull()) { return; }
+
+  Handle(Graphic3d_AspectFillArea3d) aspect = new Graphic3d_AspectFillArea3d();
+  aspect->SetInteriorStyle(Aspect_IS_SOLID);
+  aspect->SetInteriorColor(theStyle->Color());
+  aspect->SetShadingModel(Graphic3d_TypeOfShadingModel_Unlit);
+  aspect->SetPolygonOffsets(Aspect_POM_Fill, -1.0f, -1.0f);
+
+  Handle(Graphic3d_Group) group = prs->NewGroup();
+  group->SetGroupPrimitivesAspect(aspect);
+  group->AddPrimitiveArray(partTriangles);
+
+  if (isImmediate) {
+    thePM->AddToImmediateList(prs);
+  } else {
+    prs->Display();
+  }
+}
+
+void StaircaseBatchOwner::Unhilight(Handle(PrsMgr_PresentationManager) const &,
+                                    Standard_Integer const) {
+  if (!selectionPrs.IsNull()) { selectionPrs->Erase(); }
+}
+
+void StaircaseBatchOwner::Clear(Handle(PrsMgr_PresentationManager) const &,
+                                Standard_Integer const) {
+  if (!selectionPrs.IsNull()) {
+    selectionPrs->Clear();
+    selectionPrs->Erase();
+    selectionPrs.Nullify();
+  }
+}
+
+Standard_Boolean
+StaircaseBatchFilter::IsOk(Handle(SelectMgr_EntityOwner) const &theOwner) const {
+  Handle(StaircaseBatchOwner) owner =
+      Handle(StaircaseBatchOwner)::DownCast(theOwner);
+  return owner.IsNull() || owner->isPartVisible();
+}
@@ -0,0 +1,107 @@
+#ifndef STAIRCASEBATCH_HPP
+#define STAIRCASEBATCH_HPP
+#include "StaircasePart.hpp"
+#include <opencascade/AIS_InteractiveObject.hxx>
+#include <opencascade/Graphic3d_ArrayOfTriangles.hxx>
+#include <opencascade/SelectMgr_EntityOwner.hxx>
+#include <opencascade/SelectMgr_Filter.hxx>
+#include <unordered_map>
+
+/**
+ * Draws the meshes of many same-colored parts from one vertex and index
+ * buffer, so a large assembly costs one draw call per color instead of one
+ * per part.
+ *
+ * Part identity survives through a range table: every part owns a slice of
+ * the index buffer, gets its own selection owner and can be hidden by
+ * collapsing its slice into degenerate triangles. A batch of closed parts
+ * only is capped by section planes.
+ */
+class StaircaseBatch : public AIS_InteractiveObject {
+  DEFINE_STANDARD_RTTI_INLINE(StaircaseBatch, AIS_InteractiveObject)
+public:
+  struct PartRange {
+    size_t partIndex;
+    Handle(Poly_Triangulation) mesh;
+    Standard_Integer firstVertex; // 1-based, as in Graphic3d arrays
+    Standard_Integer firstEdge;   // 1-based
+    bool visible = true;
+  };
+
+  StaircaseBatch(std::optional<Quantity_Color> const &color,
+                 std::vector<StaircasePart> const &parts,
+                 std::vector<size_t> const &partIndices);
+
+  std::vector<PartRange> const &getRanges() const { return ranges; }
+  Handle(Graphic3d_ArrayOfTriangles) const &getTriangles() const {
+    return triangles;
+  }
+
+  // Returns false when the batch holds no part with that index.
+  bool setPartVisible(size_t partIndex, bool visible);
+  bool isPartVisible(size_t partIndex) const;
+
+  virtual Standard_Boolean
+  AcceptDisplayMode(Standard_Integer const theMode) const override {
+    return theMode == 0;
+  }
+
+protected:
+  virtual void Compute(Handle(PrsMgr_PresentationManager) const &thePrsMgr,
+                       Handle(Prs3d_Presentation) const &thePrs,
+                       Standard_Integer const theMode) override;
+
+  virtual void ComputeSelection(Handle(SelectMgr_Selection) const &theSel,
+                                Standard_Integer const theMode) override;
+
+private:
+  Handle(Graphic3d_ArrayOfTriangles) triangles;
+  bool isClosed = true;
+  std::vector<PartRange> ranges;
+  std::unordered_map<size_t, size_t> rangeOfPart;
+};
+
+/**
+ * Selection owner of a single part inside a StaircaseBatch. Highlighting draws
+ * only that part's triangles.
+ */
+class StaircaseBatchOwner : public SelectMgr_EntityOwner {
+  DEFINE_STANDARD_RTTI_INLINE(StaircaseBatchOwner, SelectMgr_EntityOwner)
+public:
+  StaircaseBatchOwner(Handle(StaircaseBatch) const &batch, size_t rangeIndex);
+
+  size_t getPartIndex() const;
+  bool isPartVisible() const;
+
+  virtual Standard_Boolean
+  IsHilighted(Handle(PrsMgr_PresentationManager) const &thePM,
+              Standard_Integer const theMode) const override;
+
+  virtual void
+  HilightWithColor(Handle(PrsMgr_PresentationManager) const &thePM,
+                   Handle(Prs3d_Drawer) const &theStyle,
+                   Standard_Integer const theMode) override;
+
+  virtual void Unhilight(Handle(PrsMgr_PresentationManager) const &thePM,
+                         Standard_Integer const theMode) override;
+
+  virtual void Clear(Handle(PrsMgr_PresentationManager) const &thePM,
+                     Standard_Integer const theMode) override;
+
+private:
+  size_t rangeIndex;
+  Handle(Prs3d_Presentation) selectionPrs;
+
+  StaircaseBatch const &getBatch() const;
+};
+
+/**
+ * Keeps parts hidden inside a StaircaseBatch from being detected or picked.
+ */
+class StaircaseBatchFilter : public SelectMgr_Filter {
+  DEFINE_STANDARD_RTTI_INLINE(StaircaseBatchFilter, SelectMgr_Filter)
+public:
+  virtual Standard_Boolean
+  IsOk(Handle(SelectMgr_EntityOwner) const &theOwner) const override;
+};
+#endif // STAIRCASEBATCH_HPP
@@ -0,0 +1,45 @@
+#include "StaircaseCompactMesh.hpp"
+#include "CompactVertexFormat.hpp"
+#include "StaircaseShape.hpp"
+#include <opencascade/Prs3d_ShadingAspect.hxx>
+
+StaircaseCompactMesh::StaircaseCompactMesh(
+    gp_Trsf const &dequantization,
+    Handle(Graphic3d_ViewAffinity) const &viewAffinity) {
+  myViewAffinity = viewAffinity;
+  SetLocalTransformation(dequantization);
+}
+
+StaircaseShape const *StaircaseCompactMesh::getShape() const {
+  return dynamic_cast<StaircaseShape const *>(Parent());
+}
+
+void StaircaseCompactMesh::Compute(Handle(PrsMgr_PresentationManager) const &,
+                                   Handle(Prs3d_Presentation) const &thePrs,
+                                   Standard_Integer const theMode) {
+  StaircaseShape const *shape = getShape();
+  if (shape == nullptr) { return; }
+  Handle(Poly_Triangulation) const &triangulation =
+      shape->modeTriangulation(theMode);
+  if (triangulation.IsNull()) { return; }
+
+  CompactMesh compact =
+      buildCompactMesh(triangulation, LocalTransformation());
+  if (compact.vertices.IsNull()) { return; }
+
+  // The shape's drawer, so its color applies.
+  Handle(Graphic3d_AspectFillArea3d) aspect = new Graphic3d_AspectFillArea3d(
+      *shape->Attributes()->ShadingAspect()->Aspect());
+  aspect->SetShaderProgram(compactVertexShaderProgram());
+
+  Handle(Graphic3d_Group) group = thePrs->NewGroup();
+  group->SetClosed(shape->isClosedSolid());
+  group->SetGroupPrimitivesAspect(aspect);
+  group->AddPrimitiveArray(Graphic3d_TOPA_TRIANGLES, compact.indices,
+                           compact.vertices, Handle(Graphic3d_BoundBuffer)(),
+                           Standard_False);
+  // In the unit cube; culling sees them through the transformation.
+  group->SetMinMaxValues(compact.boundsMin.x(), compact.boundsMin.y(),
+                         compact.boundsMin.z(), compact.boundsMax.x(),
+                         compact.boundsMax.y(), compact.boundsMax.z());
+}
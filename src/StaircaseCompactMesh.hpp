@@ -0,0 +1,40 @@
+#ifndef STAIRCASECOMPACTMESH_HPP
+#define STAIRCASECOMPACTMESH_HPP
+#include <opencascade/AIS_InteractiveObject.hxx>
+#include <opencascade/gp_Trsf.hxx>
+
+class StaircaseShape;
+
+/**
+ * Draws the shaded and proxy modes of a StaircaseShape in the
+ * CompactVertexFormat, as a child object of that shape.
+ *
+ * Compact vertices decode into the unit cube, so the dequantization has to
+ * reach occModelWorldMatrix. It is this object's local transformation, which
+ * OCCT composes with the shape's own transformation whenever either changes.
+ * A transformation set on the presentation in Compute would be overwritten
+ * right after it.
+ *
+ * The presentation manager displays, erases and highlights children together
+ * with their parent, in the parent's display mode. It shares the shape's view
+ * affinity, so hiding the shape from a view hides it too. There is no
+ * selection of its own; the shape is picked through its BRep as before.
+ */
+class StaircaseCompactMesh : public AIS_InteractiveObject {
+  DEFINE_STANDARD_RTTI_INLINE(StaircaseCompactMesh, AIS_InteractiveObject)
+public:
+  StaircaseCompactMesh(gp_Trsf const &dequantization,
+                       Handle(Graphic3d_ViewAffinity) const &viewAffinity);
+
+protected:
+  virtual void Compute(Handle(PrsMgr_PresentationManager) const &thePrsMgr,
+                       Handle(Prs3d_Presentation) const &thePrs,
+                       Standard_Integer const theMode) override;
+
+  virtual void ComputeSelection(Handle(SelectMgr_Selection) const &,
+                                Standard_Integer const) override {}
+
+private:
+  StaircaseShape const *getShape() const;
+};
+#endif // STAIRCASECOMPACTMESH_HPP
@@ -0,0 +1,45 @@
+#include "StaircaseDrawing.hpp"
+#include "staircase.hpp"
+#include <opencascade/Graphic3d_ArrayOfSegments.hxx>
+#include <opencascade/Prs3d_LineAspect.hxx>
+
+namespace {
+void addSegments(Handle(Prs3d_Presentation) const &thePrs,
+                 std::vector<Graphic3d_Vec3> const &vertices,
+                 Handle(Prs3d_LineAspect) const &aspect) {
+  if (vertices.empty()) { return; }
+
+  Handle(Graphic3d_ArrayOfSegments) segments =
+      new Graphic3d_ArrayOfSegments(static_cast<Standard_Integer>(vertices.size()));
+  for (Graphic3d_Vec3 const &vertex : vertices) {
+    segments->AddVertex(vertex);
+  }
+  Handle(Graphic3d_Group) group = thePrs->NewGroup();
+  group->SetGroupPrimitivesAspect(aspect->Aspect());
+  group->AddPrimitiveArray(segments);
+}
+} // namespace
+
+StaircaseDrawing::StaircaseDrawing(
+    std::shared_ptr<DrawingViewWorker::Drawing const> drawing)
+    : drawing(drawing) {
+  myDrawer->SetLineAspect(
+      new Prs3d_LineAspect(Quantity_NOC_BLACK, Aspect_TOL_SOLID, 1.5));
+  myDrawer->SetHiddenLineAspect(
+      new Prs3d_LineAspect(Quantity_NOC_GRAY40, Aspect_TOL_DASH, 1.0));
+  SetDisplayMode(AIS_WIREFRAME_MODE);
+}
+
+Standard_Boolean
+StaircaseDrawing::AcceptDisplayMode(Standard_Integer const theMode) const {
+  return theMode == AIS_WIREFRAME_MODE;
+}
+
+void StaircaseDrawing::Compute(Handle(PrsMgr_PresentationManager) const &,
+                               Handle(Prs3d_Presentation) const &thePrs,
+                               Standard_Integer const theMode) {
+  if (theMode != AIS_WIREFRAME_MODE) { return; }
+
+  addSegments(thePrs, drawing->hidden, myDrawer->HiddenLineAspect());
+  addSegments(thePrs, drawing->visible, myDrawer->LineAspect());
+}
@@ -0,0 +1,34 @@
+#ifndef STAIRCASEDRAWING_HPP
+#define STAIRCASEDRAWING_HPP
+#include "DrawingViewWorker.hpp"
+#include <opencascade/AIS_InteractiveObject.hxx>
+
+/**
+ * Technical drawing overlay: the visible edges of a DrawingViewWorker result
+ * as solid lines and the hidden ones dashed. It lies in the projection plane
+ * and is meant for the Topmost layer, so it stays on top of the model while
+ * the camera pans and zooms. The only display mode is AIS_WIREFRAME_MODE and
+ * it is not selectable.
+ */
+class StaircaseDrawing : public AIS_InteractiveObject {
+  DEFINE_STANDARD_RTTI_INLINE(StaircaseDrawing, AIS_InteractiveObject)
+public:
+  StaircaseDrawing(std::shared_ptr<DrawingViewWorker::Drawing const> drawing);
+
+  int getDirection() const { return drawing->direction; }
+
+  virtual Standard_Boolean
+  AcceptDisplayMode(Standard_Integer const theMode) const override;
+
+protected:
+  virtual void Compute(Handle(PrsMgr_PresentationManager) const &thePrsMgr,
+                       Handle(Prs3d_Presentation) const &thePrs,
+                       Standard_Integer const theMode) override;
+
+  virtual void ComputeSelection(Handle(SelectMgr_Selection) const &,
+                                Standard_Integer const) override {}
+
+private:
+  std::shared_ptr<DrawingViewWorker::Drawing const> drawing;
+};
+#endif // STAIRCASEDRAWING_HPP
@@ -0,0 +1,61 @@
+#include "StaircaseEdges.hpp"
+#include "staircase.hpp"
+#include <opencascade/Graphic3d_AttribBuffer.hxx>
+#include <opencascade/Prs3d_LineAspect.hxx>
+
+StaircaseEdges::StaircaseEdges(Handle(Graphic3d_ArrayOfSegments) const &segments,
+                               std::vector<StaircasePart> const &parts)
+    : segments(segments) {
+  ranges.reserve(parts.size());
+  for (auto const &part : parts) {
+    ranges.push_back({part.firstEdgeVertex, part.nbEdgeVertices});
+  }
+
+  myDrawer->SetLineAspect(
+      new Prs3d_LineAspect(Quantity_NOC_BLACK, Aspect_TOL_SOLID, 1.0));
+  SetDisplayMode(AIS_WIREFRAME_MODE);
+}
+
+Standard_Boolean
+StaircaseEdges::AcceptDisplayMode(Standard_Integer const theMode) const {
+  return theMode == AIS_WIREFRAME_MODE;
+}
+
+void StaircaseEdges::Compute(Handle(PrsMgr_PresentationManager) const &,
+                             Handle(Prs3d_Presentation) const &thePrs,
+                             Standard_Integer const theMode) {
+  if (theMode != AIS_WIREFRAME_MODE || segments.IsNull()) { return; }
+
+  Handle(Graphic3d_Group) group = thePrs->NewGroup();
+  group->SetGroupPrimitivesAspect(myDrawer->LineAspect()->Aspect());
+  group->AddPrimitiveArray(segments);
+}
+
+void StaircaseEdges::setPartVisible(size_t partIndex, bool visible) {
+  if (partIndex >= ranges.size() || segments.IsNull()) { return; }
+  PartRange const &range = ranges[partIndex];
+  if (range.nbVertices == 0) { return; }
+
+  auto it = hiddenVertices.find(partIndex);
+  if ((it == hiddenVertices.end()) == visible) { return; }
+
+  Standard_Integer const last = range.firstVertex + range.nbVertices - 1;
+  if (visible) {
+    for (Standard_Integer i = range.firstVertex; i <= last; ++i) {
+      segments->SetVertice(i, it->second[i - range.firstVertex]);
+    }
+    hiddenVertices.erase(it);
+  } else {
+    std::vector<gp_Pnt> &saved = hiddenVertices[partIndex];
+    saved.reserve(range.nbVertices);
+    gp_Pnt const collapsed = segments->Vertice(range.firstVertex);
+    for (Standard_Integer i = range.firstVertex; i <= last; ++i) {
+      saved.push_back(segments->Vertice(i));
+      segments->SetVertice(i, collapsed);
+    }
+  }
+
+  Handle(Graphic3d_AttribBuffer) attribs =
+      Handle(Graphic3d_AttribBuffer)::DownCast(segments->Attributes());
+  if (!attribs.IsNull()) { attribs->Invalidate(range.firstVertex - 1, last - 1); }
+}
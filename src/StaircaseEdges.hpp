@@ -0,0 +1,51 @@
+#ifndef STAIRCASEEDGES_HPP
+#define STAIRCASEEDGES_HPP
+#include "StaircasePart.hpp"
+#include <opencascade/AIS_InteractiveObject.hxx>
+#include <opencascade/Graphic3d_ArrayOfSegments.hxx>
+#include <unordered_map>
+
+/**
+ * Face boundaries of the whole model, drawn from the segment array packed on
+ * the background worker. Showing or hiding it never discretizes an edge on
+ * the main thread. The only display mode is AIS_WIREFRAME_MODE; the edges
+ * are not selectable, parts are picked through their faces.
+ *
+ * The edges of a hidden part are collapsed onto its first vertex in place;
+ * their positions are kept aside until the part is shown again.
+ */
+class StaircaseEdges : public AIS_InteractiveObject {
+  DEFINE_STANDARD_RTTI_INLINE(StaircaseEdges, AIS_InteractiveObject)
+public:
+  // Takes each part's range in `segments` from the parts packEdges filled.
+  StaircaseEdges(Handle(Graphic3d_ArrayOfSegments) const &segments,
+                 std::vector<StaircasePart> const &parts);
+
+  Handle(Graphic3d_ArrayOfSegments) const &getSegments() const {
+    return segments;
+  }
+
+  void setPartVisible(size_t partIndex, bool visible);
+
+  virtual Standard_Boolean
+  AcceptDisplayMode(Standard_Integer const theMode) const override;
+
+protected:
+  virtual void Compute(Handle(PrsMgr_PresentationManager) const &thePrsMgr,
+                       Handle(Prs3d_Presentation) const &thePrs,
+                       Standard_Integer const theMode) override;
+
+  virtual void ComputeSelection(Handle(SelectMgr_Selection) const &,
+                                Standard_Integer const) override {}
+
+private:
+  struct PartRange {
+    Standard_Integer firstVertex; // 1-based
+    Standard_Integer nbVertices;
+  };
+
+  Handle(Graphic3d_ArrayOfSegments) segments;
+  std::vector<PartRange> ranges;
+  std::unordered_map<size_t, std::vector<gp_Pnt>> hiddenVertices;
+};
+#endif // STAIRCASEEDGES_HPP
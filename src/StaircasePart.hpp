@@ -0,0 +1,73 @@
+#ifndef STAIRCASEPART_HPP
+#define STAIRCASEPART_HPP
+#include <algorithm>
+#include <array>
+#include <map>
+#include <opencascade/Bnd_Box.hxx>
+#include <opencascade/Graphic3d_Vec3.hxx>
+#include <opencascade/Poly_Triangulation.hxx>
+#include <opencascade/Quantity_Color.hxx>
+#include <opencascade/TopoDS_Shape.hxx>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Fractions of the full triangle count kept by each navigation proxy level,
+// from finest to coarsest.
+std::array<double, 3> const LOD_RATIOS = {0.25, 0.08, 0.02};
+
+// Largest number of parts the worker puts into one spatial cluster. In
+// large-model mode every color batch is split per cluster, so the renderer
+// can still cull the batches that are off screen.
+size_t const MAX_PARTS_PER_CLUSTER = 256;
+
+/**
+ * Everything the viewer needs to present one part, prepared on the background
+ * worker so the main thread only has to build presentations.
+ */
+struct StaircasePart {
+  // Null once the document has been released in mesh-only mode.
+  TopoDS_Shape shape;
+  std::optional<Quantity_Color> color;
+
+  // Made of solids bounded by closed shells only, so a section plane may cap
+  // it. Kept when the shape is released.
+  bool isClosed = false;
+
+  // Entry of the XCAF label the part was read from, e.g. "0:1:1:2".
+  std::string labelEntry;
+
+  // World space bounds of `mesh`, and the spatial cluster the part belongs to.
+  Bnd_Box bounds;
+  int cluster = 0;
+
+  // All face triangulations of the part merged into one, in world space.
+  Handle(Poly_Triangulation) mesh;
+
+  // Reduced copies of `mesh`, one per entry of LOD_RATIOS. Parts too small to
+  // simplify have fewer entries and fall back to the coarsest one available.
+  std::vector<Handle(Poly_Triangulation)> lods;
+
+  // Face boundaries as pairs of segment endpoints. Emptied by packEdges,
+  // which leaves the part's range in the packed edge array instead.
+  std::vector<Graphic3d_Vec3> edgeSegments;
+  Standard_Integer firstEdgeVertex = 0; // 1-based
+  Standard_Integer nbEdgeVertices = 0;
+
+  // End of each face's triangle range in `mesh`, in face order.
+  std::vector<Standard_Integer> faceTriangleEnds;
+
+  // Face a 1-based triangle of `mesh` belongs to, or -1.
+  int faceOfTriangle(Standard_Integer triangleIndex) const {
+    auto it = std::lower_bound(faceTriangleEnds.begin(), faceTriangleEnds.end(),
+                               triangleIndex);
+    if (it == faceTriangleEnds.end()) { return -1; }
+    return static_cast<int>(it - faceTriangleEnds.begin());
+  }
+};
+
+// Indices of the parts below every XCAF node, keyed by label entry. A node
+// holds the part read from its own label, and for assemblies and components
+// the parts of the shapes they reference.
+typedef std::map<std::string, std::vector<size_t>> StaircaseNodeParts;
+#endif // STAIRCASEPART_HPP
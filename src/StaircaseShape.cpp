@@ -0,0 +1,94 @@
+#include "StaircaseShape.hpp"
+#include "CompactVertexFormat.hpp"
+#include "OCCTUtilities.hpp"
+#include "staircase.hpp"
+#include <opencascade/Graphic3d_ArrayOfTriangles.hxx>
+#include <opencascade/Prs3d_ShadingAspect.hxx>
+
+StaircaseShape::StaircaseShape(StaircasePart const &part)
+    : AIS_Shape(part.shape), mesh(part.mesh), lods(part.lods),
+      isClosed(part.isClosed) {}
+
+Handle(Poly_Triangulation) const &
+StaircaseShape::lodTriangulation(int lodLevel) const {
+  if (lods.empty()) { return mesh; }
+  return lods[std::min<size_t>(lodLevel, lods.size() - 1)];
+}
+
+size_t StaircaseShape::nbTriangles(int lodLevel) const {
+  Handle(Poly_Triangulation) const &triangulation =
+      lodLevel < 0 ? mesh : lodTriangulation(lodLevel);
+  return triangulation.IsNull() ? 0 : triangulation->NbTriangles();
+}
+
+Standard_Boolean
+StaircaseShape::AcceptDisplayMode(Standard_Integer const theMode) const {
+  if (theMode >= AIS_LOD_MODE) {
+    return theMode < AIS_LOD_MODE + static_cast<int>(LOD_RATIOS.size());
+  }
+  return AIS_Shape::AcceptDisplayMode(theMode);
+}
+
+void StaircaseShape::setCompactVertices(bool value) {
+  if (hasCompactVertices() == value) { return; }
+  if (!value) {
+    RemoveChild(compactMesh);
+    compactMesh.Nullify();
+    SetToUpdate();
+    return;
+  }
+  if (mesh.IsNull() || !mesh->HasNormals()) { return; }
+
+  // One quantization cube for the mesh and its proxies, whose nodes may lie
+  // slightly outside the mesh.
+  Bnd_Box bounds;
+  auto addNodes = [&bounds](Handle(Poly_Triangulation) const &triangulation) {
+    for (Standard_Integer i = 1; i <= triangulation->NbNodes(); ++i) {
+      bounds.Add(triangulation->Node(i));
+    }
+  };
+  addNodes(mesh);
+  for (auto const &lod : lods) { addNodes(lod); }
+
+  compactMesh =
+      new StaircaseCompactMesh(compactDequantization(bounds), ViewAffinity());
+  AddChild(compactMesh);
+  SetToUpdate();
+}
+
+Handle(Poly_Triangulation) const &
+StaircaseShape::modeTriangulation(Standard_Integer theMode) const {
+  static Handle(Poly_Triangulation) const NONE;
+  if (theMode == AIS_SHADED_MODE) { return mesh; }
+  if (theMode >= AIS_LOD_MODE) {
+    return lodTriangulation(theMode - AIS_LOD_MODE);
+  }
+  return NONE;
+}
+
+void StaircaseShape::Compute(Handle(PrsMgr_PresentationManager) const &thePrsMgr,
+                             Handle(Prs3d_Presentation) const &thePrs,
+                             Standard_Integer const theMode) {
+  if (!compactMesh.IsNull() &&
+      (theMode == AIS_SHADED_MODE || theMode >= AIS_LOD_MODE)) {
+    return;
+  }
+  if (theMode < AIS_LOD_MODE) {
+    AIS_Shape::Compute(thePrsMgr, thePrs, theMode);
+    return;
+  }
+  computeTriangles(thePrs, lodTriangulation(theMode - AIS_LOD_MODE));
+}
+
+void StaircaseShape::computeTriangles(
+    Handle(Prs3d_Presentation) const &thePrs,
+    Handle(Poly_Triangulation) const &triangulation) {
+  Handle(Graphic3d_ArrayOfTriangles) triangles =
+      createTriangleArray(triangulation);
+  if (triangles.IsNull()) { return; }
+
+  Handle(Graphic3d_Group) group = thePrs->NewGroup();
+  group->SetClosed(isClosed);
+  group->SetGroupPrimitivesAspect(myDrawer->ShadingAspect()->Aspect());
+  group->AddPrimitiveArray(triangles);
+}
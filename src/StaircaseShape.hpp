@@ -0,0 +1,51 @@
+#ifndef STAIRCASESHAPE_HPP
+#define STAIRCASESHAPE_HPP
+#include "StaircaseCompactMesh.hpp"
+#include "StaircasePart.hpp"
+#include <opencascade/AIS_Shape.hxx>
+
+/**
+ * AIS_Shape that can also present the reduced navigation proxies of its part.
+ * Display mode AIS_LOD_MODE + n draws proxy level n; every other mode is
+ * handled by AIS_Shape. With compact vertices, the shaded and proxy modes are
+ * drawn by a StaircaseCompactMesh child instead.
+ */
+class StaircaseShape : public AIS_Shape {
+  DEFINE_STANDARD_RTTI_INLINE(StaircaseShape, AIS_Shape)
+public:
+  StaircaseShape(StaircasePart const &part);
+
+  size_t nbTriangles(int lodLevel) const;
+
+  // Adds or removes the compact child. Call it while the shape is not
+  // displayed; the next Display shows the child along with the shape. Parts
+  // without normals keep their regular presentations.
+  void setCompactVertices(bool value);
+  bool hasCompactVertices() const { return !compactMesh.IsNull(); }
+
+  // Whether the part is a closed solid, whose groups section planes cap.
+  bool isClosedSolid() const { return isClosed; }
+
+  // The triangles the shaded or a proxy mode draws, or null for other modes.
+  Handle(Poly_Triangulation) const &
+  modeTriangulation(Standard_Integer theMode) const;
+
+  virtual Standard_Boolean
+  AcceptDisplayMode(Standard_Integer const theMode) const override;
+
+protected:
+  virtual void Compute(Handle(PrsMgr_PresentationManager) const &thePrsMgr,
+                       Handle(Prs3d_Presentation) const &thePrs,
+                       Standard_Integer const theMode) override;
+
+private:
+  Handle(Poly_Triangulation) mesh;
+  std::vector<Handle(Poly_Triangulation)> lods;
+  Handle(StaircaseCompactMesh) compactMesh;
+  bool isClosed;
+
+  Handle(Poly_Triangulation) const &lodTriangulation(int lodLevel) const;
+  void computeTriangles(Handle(Prs3d_Presentation) const &thePrs,
+                        Handle(Poly_Triangulation) const &triangulation);
+};
+#endif // STAIRCASESHAPE_HPP
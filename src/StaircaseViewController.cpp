@@ -2,27 +2,110 @@
 #include "ViewerContext.hpp"
 #include "OCCTUtilities.hpp"
 #include "staircase.hpp"
+#include "TaskPool.hpp"
 #include <AIS_ViewCube.hxx>
 #include <Wasm_Window.hxx>
 #include <opencascade/AIS_InteractiveContext.hxx>
 #include <opencascade/AIS_Shape.hxx>
+#include <opencascade/OpenGl_Context.hxx>
+#include <opencascade/OpenGl_FrameStats.hxx>
 #include <opencascade/OpenGl_GraphicDriver.hxx>
+#include <opencascade/Precision.hxx>
+#include <opencascade/BVH_BinnedBuilder.hxx>
+#include <opencascade/BVH_LinearBuilder.hxx>
 #include <opencascade/Prs3d_DatumAspect.hxx>
+#include <opencascade/Select3D_SensitiveTriangulation.hxx>
+#include <opencascade/SelectMgr_Selection.hxx>
+#include <opencascade/SelectMgr_ViewerSelector.hxx>
 #include <opencascade/TDocStd_Document.hxx>
 #include <opencascade/TopoDS_Shape.hxx>
 #include <opencascade/V3d_View.hxx>
+#include <opencascade/gp_Lin.hxx>
+#include <algorithm>
+#include <cstdint>
+#include <map>
 
-// Update canvas bounding rectangle.
-EM_JS(void, jsUpdateBoundingClientRect, (),
-      { Module._myCanvasRect = Module.canvas.getBoundingClientRect(); });
+// Total triangle count the view can orbit smoothly. Larger models switch to
+// the first proxy level that fits while the camera moves.
+size_t const LOD_TRIANGLE_BUDGET = 2000000;
 
-// Get canvas bounding top.
-EM_JS(int, jsGetBoundingClientTop, (),
-      { return Math.round(Module._myCanvasRect.top); });
+// How long the camera must rest before full meshes are drawn again.
+std::chrono::milliseconds const LOD_IDLE_DELAY(200);
 
-// Get canvas bounding left.
-EM_JS(int, jsGetBoundingClientLeft, (),
-      { return Math.round(Module._myCanvasRect.left); });
+// Limits of the occluder set, which is rasterized on the CPU every time the
+// camera moves.
+size_t const MAX_OCCLUDERS = 64;
+size_t const OCCLUDER_TRIANGLE_BUDGET = 30000;
+
+// Time per frame spent on activating selections while the user is idle.
+std::chrono::microseconds const SELECTION_IDLE_BUDGET(4000);
+
+// Scene build budget while the camera moves, so navigation stays smooth.
+std::chrono::microseconds const NAVIGATION_BUILD_BUDGET(2000);
+
+// Margin around object bounds when looking for objects under the cursor.
+int const SELECTION_MARGIN_PX = 4;
+
+namespace {
+Handle(Select3D_BVHBuilder3d) createPickingBvhBuilder() {
+  return new BVH_BinnedBuilder<Standard_Real, 3, BVH_Constants_NbBinsOptimal>(
+      BVH_Constants_LeafNodeSizeAverage, BVH_Constants_MaxTreeDepth);
+}
+} // namespace
+
+// Offset of a canvas in the viewport, written to offset[0] (left) and
+// offset[1] (top). Reading the bounding rect forces a layout, so it is cached
+// per canvas until something scrolls, the window resizes or the canvas
+// changes size.
+EM_JS(void, jsGetCanvasOffset, (char const *canvasId, int *offset), {
+  if (!Module._canvasOffsets) {
+    let offsets = new Map();
+    let invalidate = () => offsets.clear();
+    // Capturing also catches scrolling inside other elements.
+    window.addEventListener("scroll", invalidate, {capture: true, passive: true});
+    window.addEventListener("resize", invalidate, {passive: true});
+    Module._canvasOffsets = offsets;
+    Module._canvasResizeObserver = new ResizeObserver(invalidate);
+    Module._observedCanvases = new Map();
+  }
+  let id = UTF8ToString(canvasId);
+  let cached = Module._canvasOffsets.get(id);
+  if (cached === undefined) {
+    let canvas = document.getElementById(id);
+    if (!canvas) {
+      cached = [0, 0];
+    } else {
+      if (!Module._observedCanvases.has(id)) {
+        Module._observedCanvases.set(id, canvas);
+        Module._canvasResizeObserver.observe(canvas);
+      }
+      let rect = canvas.getBoundingClientRect();
+      cached = [Math.round(rect.left), Math.round(rect.top)];
+      Module._canvasOffsets.set(id, cached);
+    }
+  }
+  HEAP32[offset >> 2] = cached[0];
+  HEAP32[(offset >> 2) + 1] = cached[1];
+});
+
+// Drops the cached offset of a canvas and stops observing it. The element
+// observed is kept, as it may have left the document by now.
+EM_JS(void, jsForgetCanvas, (char const *canvasId), {
+  if (!Module._canvasOffsets) { return; }
+  let id = UTF8ToString(canvasId);
+  Module._canvasOffsets.delete(id);
+  let canvas = Module._observedCanvases.get(id);
+  if (canvas) {
+    Module._canvasResizeObserver.unobserve(canvas);
+    Module._observedCanvases.delete(id);
+  }
+});
+
+StaircaseViewController::~StaircaseViewController() {
+  FramePump::instance().cancel(this);
+  InputDispatcher::instance().remove(this);
+  jsForgetCanvas(canvasId.c_str());
+}
 
 void StaircaseViewController::initWindow() {
   debugOut("StaircaseViewController::initWindow()");
@@ -30,13 +113,16 @@ void StaircaseViewController::initWindow() {
   devicePixelRatio = emscripten_get_device_pixel_ratio();
 
   auto canvasTarget = getCanvasTag();
-  auto windowTarget = EMSCRIPTEN_EVENT_TARGET_WINDOW;
   const EM_BOOL useCapture = EM_TRUE;
 
+  // Which viewer owns the pointer decides where window events go.
   auto mouseCallback = [](int eventType, EmscriptenMouseEvent const *event,
                           void *userData) -> EM_BOOL {
-    return static_cast<StaircaseViewController *>(userData)->onMouseEvent(
-        eventType, event);
+    auto controller = static_cast<StaircaseViewController *>(userData);
+    InputDispatcher::instance().onCanvasMouseEvent(controller, eventType,
+                                                   event);
+    if (eventType == EMSCRIPTEN_EVENT_MOUSELEAVE) { return EM_FALSE; }
+    return controller->onMouseEvent(eventType, event);
   };
 
   auto wheelCallback = [](int eventType, EmscriptenWheelEvent const *event,
@@ -69,20 +155,16 @@ void StaircaseViewController::initWindow() {
         eventType, event);
   };
 
-  auto resizeCallback = [](int eventType, EmscriptenUiEvent const *event,
-                           void *userData) -> EM_BOOL {
-    return static_cast<StaircaseViewController *>(userData)->onResizeEvent(
-        eventType, event);
-  };
+  // Resizes, releases and moves come from the window, through the
+  // dispatcher shared by all viewers.
+  InputDispatcher::instance().add(this);
 
   // clang-format off
-  emscripten_set_resize_callback     (windowTarget, this, useCapture, resizeCallback);
   emscripten_set_mousedown_callback  (canvasTarget, this, useCapture, mouseCallback);
-  emscripten_set_mouseup_callback    (windowTarget, this, useCapture, mouseCallback);
-  emscripten_set_mousemove_callback  (windowTarget, this, useCapture, mouseCallback);
   emscripten_set_dblclick_callback   (canvasTarget, this, useCapture, mouseCallback);
   emscripten_set_click_callback      (canvasTarget, this, useCapture, mouseCallback);
   emscripten_set_mouseenter_callback (canvasTarget, this, useCapture, mouseCallback);
+  emscripten_set_mouseleave_callback (canvasTarget, this, useCapture, mouseCallback);
   emscripten_set_wheel_callback      (canvasTarget, this, useCapture, wheelCallback);
 
   emscripten_set_touchstart_callback (canvasTarget, this, useCapture, touchCallback);
@@ -155,9 +237,24 @@ bool StaircaseViewController::initViewer() {
   view->ChangeRenderingParams().ToShowStats = false;
   view->ChangeRenderingParams().StatsTextAspect = textAspect->Aspect();
   view->ChangeRenderingParams().StatsTextHeight = textAspect->Height();
+  // Structure and triangle counters of every frame, for getCullingStats.
+  view->ChangeRenderingParams().CollectedStats =
+      Graphic3d_RenderingParams::PerfCounters(
+          Graphic3d_RenderingParams::PerfCounters_Structures |
+          Graphic3d_RenderingParams::PerfCounters_Triangles);
+  view->ChangeRenderingParams().StatsUpdateInterval = 0.0;
   view->SetWindow(aWindow);
 
   aisContext = new AIS_InteractiveContext(aViewer);
+  aisContext->AddFilter(new StaircaseBatchFilter());
+
+  // Picking BVHs are built with binned SAH, by the BvhPrebuilder on the
+  // TaskPool while idle. The selector's own prebuild threads stay off, as
+  // every viewer would start its own.
+  Handle(Select3D_BVHBuilder3d) bvhBuilder = createPickingBvhBuilder();
+  Select3D_SensitiveSet::SetDefaultBVHBuilder(bvhBuilder);
+  aisContext->MainSelector()->SetEntitySetBuilder(bvhBuilder);
+  setCullingSize(cullingSize);
 
   if (viewCube.IsNull()) {
     initScene();
@@ -208,6 +305,11 @@ void StaircaseViewController::initScene() {
   viewCube->Attributes()->DatumAspect()->SetTextAspect(textAspect);
   viewCube->SetViewAnimation(myViewAnimation);
   viewCube->SetFixedAnimationLoop(false);
+  // Section planes apply to the model, not to the view cube.
+  Handle(Graphic3d_SequenceOfHClipPlane) noClipping =
+      new Graphic3d_SequenceOfHClipPlane();
+  noClipping->SetToOverrideGlobal(true);
+  viewCube->SetClipPlanes(noClipping);
   viewCube->SetAutoStartAnimation(true);
   aisContext->Display(viewCube, false);
 }
@@ -219,42 +321,1103 @@ void StaircaseViewController::removeAllObjects() {
     aisContext->Remove(shape, false);
     aisContext->Erase(shape, false);
   }
-  if (!activeShapes.empty()) {
+  for (auto const &batch : activeBatches) {
+    aisContext->Remove(batch, false);
+  }
+  navigationLod = -1;
+  showingNavigationLod = false;
+  pendingParts = nullptr;
+  pendingBatches.clear();
+  clearOcclusion();
+  clearHover();
+  sceneBounds.clear();
+  nodeParts.clear();
+  partVisible.clear();
+  hideDrawingView();
+  drawingCache.clear();
+  partShapes.clear();
+  batchOfPart.clear();
+  if (hoverPickerHasScene) {
+    hoverPicker->setMeshes({});
+    hoverPicker->setHiddenParts({});
+    hoverPickerHasScene = false;
+  }
+  if (bvhPrebuilder) { bvhPrebuilder->clear(); }
+  selectables.clear();
+  selectableIndices.clear();
+  nextIdleSelectable = 0;
+  selectionStats = SelectionStats();
+  if (!activeEdges.IsNull()) {
+    aisContext->Remove(activeEdges, false);
+    activeEdges.Nullify();
+    this->updateView();
+  }
+  if (!activeShapes.empty() || !activeBatches.empty()) {
     activeShapes.clear();
+    activeBatches.clear();
     this->updateView();
   }
 }
-void StaircaseViewController::initStepFile(Handle(TDocStd_Document) aDoc) {
-  debugOut("StaircaseViewController::initStepFile(Handle(TDocStd_Document))");
-
-  if (aDoc.IsNull() || aisContext.IsNull()) {
-    std::cerr << "No document or AIS context." << std::endl;
+void StaircaseViewController::initStepFile(
+    std::vector<StaircasePart> const &parts,
+    Handle(Graphic3d_ArrayOfSegments) const &edges,
+    StaircaseNodeParts const &nodes) {
+  debugOut("StaircaseViewController::initStepFile(std::vector<StaircasePart>)");
+
+  if (aisContext.IsNull()) {
+    std::cerr << "No AIS context." << std::endl;
   }
 
   removeAllObjects();
 
-  std::vector<TopoDS_Shape> shapes = getShapesFromDoc(aDoc);
-  debugOut("shapes.size(): ", shapes.size());
+  debugOut("parts.size(): ", parts.size());
+
+  pendingParts = &parts;
+  nextPending = 0;
+  sceneBuildStats = SceneBuildStats();
+  sceneBuildStats.partsTotal = parts.size();
+  sceneBuildStart = std::chrono::steady_clock::now();
+  sceneBounds.reset(parts);
+  partVisible.assign(parts.size(), true);
+  nodeParts = nodes;
+  partShapes.reserve(parts.size());
+  for (auto const &part : parts) {
+    partShapes.push_back(part.shape);
+  }
+
+  // Parts whose BRep was released can only be drawn from their meshes.
+  bool const meshOnly =
+      std::any_of(parts.begin(), parts.end(),
+                  [](StaircasePart const &part) { return part.shape.IsNull(); });
+  if (largeModelMode || meshOnly) {
+    // One batch per spatial cluster and color, with closed and open parts
+    // apart so the closed ones get section caps. Uncolored parts share the
+    // {-1, -1, -1} color drawn with the default material.
+    std::map<std::array<int, 5>, std::vector<size_t>> partsByColor;
+    for (size_t i = 0; i < parts.size(); ++i) {
+      int const isClosed = parts[i].isClosed ? 1 : 0;
+      std::array<int, 5> key = {parts[i].cluster, isClosed, -1, -1, -1};
+      if (parts[i].color.has_value()) {
+        Quantity_Color const &color = parts[i].color.value();
+        key = {parts[i].cluster, isClosed, int(color.Red() * 255.0 + 0.5),
+               int(color.Green() * 255.0 + 0.5),
+               int(color.Blue() * 255.0 + 0.5)};
+      }
+      partsByColor[key].push_back(i);
+    }
+    for (auto &[key, partIndices] : partsByColor) {
+      pendingBatches.push_back(std::move(partIndices));
+    }
+    // Parts of batches not built yet keep an out of range batch index.
+    batchOfPart.assign(parts.size(), {SIZE_MAX, 0});
+  } else {
+    activeShapes.reserve(parts.size());
+  }
+
+  if (!edges.IsNull()) { activeEdges = new StaircaseEdges(edges, parts); }
+  applyDisplayStyle();
+}
+
+bool StaircaseViewController::continueStepFile(
+    std::chrono::steady_clock::time_point turnEnd) {
+  if (pendingParts == nullptr) { return true; }
+
+  std::vector<StaircasePart> const &parts = *pendingParts;
+  auto const frameStart = std::chrono::steady_clock::now();
+  auto const budget = isNavigating()
+                          ? std::min(sceneBuildBudget, NAVIGATION_BUILD_BUDGET)
+                          : sceneBuildBudget;
+  auto const deadline = std::min(frameStart + budget, turnEnd);
+  size_t partsAdded = 0;
+
+  bool const useBatches = !pendingBatches.empty();
+  size_t const nbPending = useBatches ? pendingBatches.size() : parts.size();
+
+  // At least one part or batch per frame, however small the budget.
+  while (nextPending < nbPending) {
+    if (useBatches) {
+      std::vector<size_t> const &partIndices = pendingBatches[nextPending];
+      displayBatch(parts, partIndices);
+      partsAdded += partIndices.size();
+    } else {
+      displayShape(parts[nextPending]);
+      ++partsAdded;
+    }
+    ++nextPending;
+    if (std::chrono::steady_clock::now() >= deadline) { break; }
+  }
+
+  auto const frameEnd = std::chrono::steady_clock::now();
+  sceneBuildStats.partsAdded += partsAdded;
+  sceneBuildStats.frames += 1;
+  sceneBuildStats.lastFrameParts = partsAdded;
+  sceneBuildStats.maxFrameParts =
+      std::max(sceneBuildStats.maxFrameParts, partsAdded);
+  sceneBuildStats.lastFrameMs =
+      std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+  sceneBuildStats.totalMs =
+      std::chrono::duration<double, std::milli>(frameEnd - sceneBuildStart)
+          .count();
+
+  bool const isDone = nextPending == nbPending;
+  if (isDone) {
+    pendingParts = nullptr;
+    pendingBatches.clear();
+    sceneBuildStats.done = true;
+    debugOut("activeShapes.size(): ", activeShapes.size(),
+             ", activeBatches.size(): ", activeBatches.size());
+    std::cout << "[SCENE] " << sceneBuildStats.partsTotal << " parts in "
+              << sceneBuildStats.frames << " frames, "
+              << sceneBuildStats.totalMs << "ms" << std::endl;
+    selectNavigationLod();
+    selectOccluders(parts);
+    setHoverScene(parts);
+  }
+
+  // Frame the model as soon as something is on screen and again once it is
+  // complete.
+  if (sceneBuildStats.frames == 1 || isDone) { fitScene(); }
+  this->updateView();
+  return isDone;
+}
+
+void StaircaseViewController::displayShape(StaircasePart const &part) {
+  // Color and display mode go into the drawer before the first Compute, and
+  // the viewer is only updated once per frame.
+  Handle(StaircaseShape) aisShape = new StaircaseShape(part);
+  aisShape->setCompactVertices(compactVertexFormat);
+  aisShape->SetDisplayMode(AIS_SHADED_MODE);
+  if (part.color.has_value()) { aisShape->SetColor(part.color.value()); }
+
+  // Parts hidden before they were built still get their presentation, so
+  // showing them later costs no more than for any other part.
+  bool const isVisible = partVisible[activeShapes.size()];
+  aisContext->Display(aisShape, AIS_SHADED_MODE, -1, false);
+  if (displayStyle == DisplayStyle::Wireframe || !isVisible) {
+    aisContext->Erase(aisShape, false);
+  }
+  sceneBounds.setPartShown(activeShapes.size(), isVisible);
+  activeShapes.push_back(aisShape);
+  addSelectable(aisShape, part.bounds);
+}
+
+void StaircaseViewController::displayBatch(
+    std::vector<StaircasePart> const &parts,
+    std::vector<size_t> const &partIndices) {
+  Handle(StaircaseBatch) batch =
+      new StaircaseBatch(parts[partIndices.front()].color, parts, partIndices);
+  batch->SetDisplayMode(0);
+  for (size_t partIndex : partIndices) {
+    if (!partVisible[partIndex]) { batch->setPartVisible(partIndex, false); }
+  }
+  aisContext->Display(batch, 0, -1, Standard_False);
+  if (displayStyle == DisplayStyle::Wireframe) {
+    aisContext->Erase(batch, false);
+  }
+  activeBatches.push_back(batch);
+  for (size_t i = 0; i < batch->getRanges().size(); ++i) {
+    batchOfPart[batch->getRanges()[i].partIndex] = {activeBatches.size() - 1, i};
+  }
+
+  Bnd_Box bounds;
+  for (size_t partIndex : partIndices) {
+    bounds.Add(parts[partIndex].bounds);
+    sceneBounds.setPartShown(partIndex, partVisible[partIndex]);
+  }
+  addSelectable(batch, bounds);
+}
+
+void StaircaseViewController::addSelectable(
+    Handle(AIS_InteractiveObject) const &object, Bnd_Box const &bounds) {
+  selectableIndices[object.get()] = selectables.size();
+  selectables.push_back({object, bounds});
+  selectionStats.objects = selectables.size();
+}
+
+void StaircaseViewController::redisplay(
+    Handle(AIS_InteractiveObject) const &object) {
+  aisContext->Display(object, object->DisplayMode(), -1, false);
+  // Erase deactivated the selection modes and Display brings none back.
+  // The sensitive entities are kept, so activating again is cheap.
+  auto const it = selectableIndices.find(object.get());
+  if (it != selectableIndices.end() && selectables[it->second].isActive) {
+    aisContext->Activate(object, 0);
+  }
+}
+
+void StaircaseViewController::activateSelection(Selectable &selectable,
+                                                bool isOnDemand) {
+  // A prebuilding object is activated once its BVHs are done; until then
+  // the prebuilder's jobs own its sensitive sets.
+  if (selectable.isActive || selectable.isPrebuilding) { return; }
+  selectable.isActive = true;
+
+  auto const start = std::chrono::steady_clock::now();
+  aisContext->Activate(selectable.object, 0);
+  selectionStats.activationMs += std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+  selectionStats.activated += 1;
+  selectionStats.activatedOnDemand += isOnDemand ? 1 : 0;
+}
+
+void StaircaseViewController::activateSelectionAt(Graphic3d_Vec2i const &point) {
+  if (selectionStats.activated == selectables.size()) { return; }
+
+  Standard_Real x, y, z, dx, dy, dz;
+  view->ConvertWithProj(point.x(), point.y(), x, y, z, dx, dy, dz);
+  gp_Lin const ray(gp_Pnt(x, y, z), gp_Dir(dx, dy, dz));
+  Standard_Real const margin = view->Convert(SELECTION_MARGIN_PX);
+
+  for (auto &selectable : selectables) {
+    if (selectable.isActive || selectable.isPrebuilding ||
+        selectable.bounds.IsVoid()) {
+      continue;
+    }
+    Bnd_Box bounds = selectable.bounds;
+    bounds.Enlarge(margin);
+    if (!bounds.IsOut(ray)) { activateSelection(selectable, true); }
+  }
+}
+
+void StaircaseViewController::activateAllSelections() {
+  for (auto &selectable : selectables) {
+    activateSelection(selectable, true);
+  }
+}
+
+bool StaircaseViewController::continueSelectionActivation(
+    std::chrono::steady_clock::time_point turnEnd) {
+  if (isBuildingScene()) { return false; }
+  // Leave the frame to the camera while the user navigates.
+  if (isNavigating()) { return false; }
+
+  auto const deadline = std::min(
+      std::chrono::steady_clock::now() + SELECTION_IDLE_BUDGET, turnEnd);
+  while (nextIdleSelectable < selectables.size()) {
+    prebuildSelection(selectables[nextIdleSelectable++]);
+    if (std::chrono::steady_clock::now() >= deadline) { return false; }
+  }
+  return true;
+}
+
+void StaircaseViewController::prebuildSelection(Selectable &selectable) {
+  if (!bvhPrebuilder) {
+    activateSelection(selectable, false);
+    return;
+  }
+  if (selectable.isActive || selectable.isPrebuilding) { return; }
+
+  // Sensitive entities are computed here, their BVHs on the TaskPool.
+  auto const start = std::chrono::steady_clock::now();
+  if (!selectable.object->HasSelection(0)) {
+    selectable.object->RecomputePrimitives(0);
+  }
+  selectable.isPrebuilding = true;
+  bvhPrebuilder->push(selectable.object);
+  selectionStats.activationMs += std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+}
+
+void StaircaseViewController::initBvhPrebuilder(std::function<void()> onBuilt) {
+  bvhPrebuilder = std::make_unique<BvhPrebuilder>(onBuilt);
+}
+
+void StaircaseViewController::applyPrebuiltSelections() {
+  if (!bvhPrebuilder) { return; }
+  for (auto const &object : bvhPrebuilder->takeBuilt()) {
+    // Objects of a scene removed since are not found.
+    auto const it = selectableIndices.find(object.get());
+    if (it == selectableIndices.end()) { continue; }
+    Selectable &selectable = selectables[it->second];
+    if (!selectable.isPrebuilding) { continue; }
+    selectable.isPrebuilding = false;
+    activateSelection(selectable, false);
+  }
+}
+
+StaircaseViewController::SelectionStats const &
+StaircaseViewController::getSelectionStats() const {
+  return selectionStats;
+}
+
+StaircaseViewController::PickingBenchmark
+StaircaseViewController::benchmarkPicking(int nbPicks) {
+  PickingBenchmark result;
+  if (aisContext.IsNull() || view.IsNull()) { return result; }
+
+  auto msSince = [](std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  activateAllSelections();
+  result.activationMs = msSince(start);
+
+  // Objects still queued in the BvhPrebuilder are left to it.
+  std::vector<Handle(Select3D_SensitiveSet)> sets;
+  for (auto const &selectable : selectables) {
+    if (!selectable.isActive) { continue; }
+    for (auto const &selection : selectable.object->Selections()) {
+      for (auto const &entity : selection->Entities()) {
+        Handle(Select3D_SensitiveSet) set =
+            Handle(Select3D_SensitiveSet)::DownCast(entity->BaseSensitive());
+        if (set.IsNull()) { continue; }
+        sets.push_back(set);
+        if (set->IsKind(STANDARD_TYPE(Select3D_SensitiveTriangulation))) {
+          result.triangles += set->NbSubElements();
+        }
+      }
+    }
+  }
+  result.entities = sets.size();
+
+  auto timeBuilds = [&](Handle(Select3D_BVHBuilder3d) const &builder) {
+    auto const buildStart = std::chrono::steady_clock::now();
+    for (auto const &set : sets) {
+      set->SetBuilder(builder);
+      set->MarkDirty();
+      set->BVH();
+    }
+    return msSince(buildStart);
+  };
+  result.linearBuildMs = timeBuilds(
+      new BVH_LinearBuilder<Standard_Real, 3>(BVH_Constants_LeafNodeSizeSingle,
+                                              BVH_Constants_MaxTreeDepth));
+  result.binnedBuildMs = timeBuilds(Select3D_SensitiveSet::DefaultBVHBuilder());
+
+  // The same builds dealt out to the TaskPool, as the prebuilder runs them.
+  // Waiting here is fine for a benchmark: the pool threads already exist.
+  TaskPool &pool = TaskPool::instance();
+  size_t const nbJobs = std::max<size_t>(pool.size(), 1);
+  start = std::chrono::steady_clock::now();
+  std::vector<std::future<void>> builds;
+  for (size_t job = 0; job < nbJobs; ++job) {
+    builds.push_back(pool.submit([&sets, job, nbJobs]() {
+      for (size_t i = job; i < sets.size(); i += nbJobs) {
+        sets[i]->MarkDirty();
+        sets[i]->BVH();
+      }
+    }));
+  }
+  for (auto &build : builds) {
+    build.wait();
+  }
+  result.pooledBuildMs = msSince(start);
+
+  // The selector's own tree over all objects is rebuilt before timing picks.
+  aisContext->MainSelector()->Pick(0, 0, view);
+  Handle(SelectMgr_ViewerSelector) const &selector = aisContext->MainSelector();
+  uint32_t seed = 12345;
+  auto nextRandom = [&seed](int range) {
+    seed = seed * 1664525u + 1013904223u;
+    return int((seed >> 8) % uint32_t(std::max(range, 1)));
+  };
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < nbPicks; ++i) {
+    selector->Pick(nextRandom(windowSize.x()), nextRandom(windowSize.y()), view);
+  }
+  result.pickMs = nbPicks > 0 ? msSince(start) / nbPicks : 0.0;
+
+  std::cout << "[PICKING] " << result.entities << " sets, " << result.triangles
+            << " triangles; BVH linear " << result.linearBuildMs
+            << "ms, binned " << result.binnedBuildMs << "ms, binned on "
+            << nbJobs << " pool jobs " << result.pooledBuildMs << "ms; pick "
+            << result.pickMs << "ms" << std::endl;
+  return result;
+}
+
+void StaircaseViewController::handleDynamicHighlight(
+    Handle(AIS_InteractiveContext) const &theCtx,
+    Handle(V3d_View) const &theView) {
+  if (offThreadHover && hoverPickerHasScene && myGL.MoveTo.ToHilight &&
+      !myGL.Dragging.ToStart) {
+    // The picker answers through applyHoverResult.
+    myGL.MoveTo.ToHilight = false;
+    hoverPoint = myGL.MoveTo.Point;
+
+    Standard_Real x, y, z, dx, dy, dz;
+    view->ConvertWithProj(hoverPoint.x(), hoverPoint.y(), x, y, z, dx, dy, dz);
+    hoverPicker->request(gp_Lin(gp_Pnt(x, y, z), gp_Dir(dx, dy, dz)));
+    return;
+  }
+
+  if (myGL.MoveTo.ToHilight) { activateSelectionAt(myGL.MoveTo.Point); }
+  AIS_ViewController::handleDynamicHighlight(theCtx, theView);
+}
+
+void StaircaseViewController::initHoverPicker(std::function<void()> onResult) {
+  hoverPicker = std::make_unique<HoverPicker>(onResult);
+}
+
+void StaircaseViewController::setOffThreadHover(bool value) {
+  offThreadHover = value;
+  if (!value) { clearHover(); }
+}
+
+void StaircaseViewController::setHoverScene(
+    std::vector<StaircasePart> const &parts) {
+  if (!hoverPicker) { return; }
+
+  std::vector<Handle(Poly_Triangulation)> meshes;
+  meshes.reserve(parts.size());
+  for (auto const &part : parts) {
+    meshes.push_back(part.mesh);
+  }
+  hoverPicker->setMeshes(std::move(meshes));
+  hoverPickerHasScene = !parts.empty();
+
+  // Parts hidden while the scene was built.
+  if (std::find(partVisible.begin(), partVisible.end(), false) !=
+      partVisible.end()) {
+    std::vector<bool> hidden(partVisible.size());
+    for (size_t i = 0; i < partVisible.size(); ++i) {
+      hidden[i] = !partVisible[i];
+    }
+    hoverPicker->setHiddenParts(std::move(hidden));
+  }
+}
+
+void StaircaseViewController::applyHoverResult() {
+  int partIndex = -1;
+  if (!hoverPicker || !hoverPicker->takeResult(partIndex)) { return; }
+
+  // Hidden parts are not hovered.
+  Handle(StaircaseBatch) batch;
+  size_t rangeIndex = 0;
+  if (partIndex >= 0 && size_t(partIndex) < batchOfPart.size() &&
+      batchOfPart[partIndex].first < activeBatches.size()) {
+    batch = activeBatches[batchOfPart[partIndex].first];
+    rangeIndex = batchOfPart[partIndex].second;
+    if (!batch->getRanges()[rangeIndex].visible) { partIndex = -1; }
+  } else if (partIndex >= 0 && (size_t(partIndex) >= activeShapes.size() ||
+                                !partVisible[partIndex])) {
+    partIndex = -1;
+  }
+
+  if (partIndex < 0) {
+    clearHover();
+    // Nothing of the model is under the cursor, so the regular detection is
+    // cheap and still highlights the view cube.
+    aisContext->MoveTo(hoverPoint.x(), hoverPoint.y(), view, false);
+    this->updateView();
+    return;
+  }
+  if (partIndex == hoveredPart) { return; }
+
+  clearHover();
+  aisContext->ClearDetected(false);
+  hoveredPart = partIndex;
+  Handle(Prs3d_Drawer) const &style =
+      aisContext->HighlightStyle(Prs3d_TypeOfHighlight_Dynamic);
+  if (!batch.IsNull()) {
+    hoveredOwner = new StaircaseBatchOwner(batch, rangeIndex);
+    hoveredOwner->HilightWithColor(aisContext->MainPrsMgr(), style, 0);
+  } else {
+    Handle(AIS_InteractiveObject) const &shape = activeShapes[partIndex];
+    // A selected shape keeps its selection highlight.
+    if (!aisContext->IsSelected(shape)) {
+      hoveredShape = shape;
+      aisContext->HilightWithColor(shape, style, false);
+    }
+  }
+  this->updateView();
+}
+
+void StaircaseViewController::clearHover() {
+  hoveredPart = -1;
+  if (!hoveredOwner.IsNull()) {
+    hoveredOwner->Clear(aisContext->MainPrsMgr(), 0);
+    hoveredOwner.Nullify();
+  }
+  if (!hoveredShape.IsNull()) {
+    if (!aisContext->IsSelected(hoveredShape)) {
+      aisContext->Unhilight(hoveredShape, false);
+    }
+    hoveredShape.Nullify();
+  }
+}
+
+void StaircaseViewController::handleSelectionPick(
+    Handle(AIS_InteractiveContext) const &theCtx,
+    Handle(V3d_View) const &theView) {
+  if (myGL.Selection.Tool == AIS_ViewSelectionTool_Picking) {
+    for (Graphic3d_Vec2i const &point : myGL.Selection.Points) {
+      activateSelectionAt(point);
+    }
+  } else if (!myGL.Selection.Points.IsEmpty()) {
+    // Rubber band and polygon selection can reach any object.
+    activateAllSelections();
+  }
+  AIS_ViewController::handleSelectionPick(theCtx, theView);
+}
+
+bool StaircaseViewController::isBuildingScene() const {
+  return pendingParts != nullptr;
+}
+
+void StaircaseViewController::setSceneBuildBudget(double milliseconds) {
+  sceneBuildBudget = std::chrono::microseconds(
+      static_cast<long long>(std::max(0.0, milliseconds) * 1000.0));
+}
+
+StaircaseViewController::SceneBuildStats const &
+StaircaseViewController::getSceneBuildStats() const {
+  return sceneBuildStats;
+}
+
+void StaircaseViewController::setDisplayStyle(DisplayStyle style) {
+  if (displayStyle == style) { return; }
+  displayStyle = style;
+  if (aisContext.IsNull()) { return; }
+
+  applyDisplayStyle();
+  this->updateView();
+}
+
+void StaircaseViewController::applyDisplayStyle() {
+  // Erased objects keep their presentations, so switching back and forth
+  // only toggles what is drawn.
+  auto setShown = [this](Handle(AIS_InteractiveObject) const &object,
+                         bool toShow) {
+    if (aisContext->IsDisplayed(object) == toShow) { return; }
+    if (toShow) {
+      redisplay(object);
+    } else {
+      aisContext->Erase(object, false);
+    }
+  };
+
+  bool const showSurfaces = displayStyle != DisplayStyle::Wireframe;
+  for (size_t i = 0; i < activeShapes.size(); ++i) {
+    setShown(activeShapes[i], showSurfaces && partVisible[i]);
+  }
+  for (auto const &batch : activeBatches) {
+    setShown(batch, showSurfaces);
+  }
+
+  if (activeEdges.IsNull()) { return; }
+  bool const showEdges = displayStyle != DisplayStyle::Shaded;
+  if (showEdges && !aisContext->IsDisplayed(activeEdges)) {
+    aisContext->Display(activeEdges, AIS_WIREFRAME_MODE, -1, false);
+  } else if (!showEdges) {
+    aisContext->Erase(activeEdges, false);
+  }
+}
+
+void StaircaseViewController::setCullingSize(int pixels) {
+  cullingSize = std::max(0, pixels);
+  if (aisContext.IsNull()) { return; }
+
+  // The default layer already frustum culls its structures through a BVH
+  // over their bounds; this adds culling of the ones that project smaller
+  // than `cullingSize` pixels.
+  Handle(V3d_Viewer) const &viewer = aisContext->CurrentViewer();
+  Graphic3d_ZLayerSettings settings =
+      viewer->ZLayerSettings(Graphic3d_ZLayerId_Default);
+  settings.SetCullingSize(cullingSize > 0 ? double(cullingSize)
+                                          : Precision::Infinite());
+  viewer->SetZLayerSettings(Graphic3d_ZLayerId_Default, settings);
+  this->updateView();
+}
+
+StaircaseViewController::CullingStats
+StaircaseViewController::getCullingStats() const {
+  CullingStats stats;
+  if (aisContext.IsNull()) { return stats; }
+
+  Handle(OpenGl_GraphicDriver) driver = Handle(OpenGl_GraphicDriver)::DownCast(
+      aisContext->CurrentViewer()->Driver());
+  if (driver.IsNull() || driver->GetSharedContext().IsNull()) { return stats; }
+
+  Graphic3d_FrameStatsData const &frame =
+      driver->GetSharedContext()->FrameStats()->LastDataFrame();
+  stats.structures = frame[Graphic3d_FrameStatsCounter_NbStructs];
+  stats.drawn = frame[Graphic3d_FrameStatsCounter_NbStructsNotCulled];
+  stats.culled = stats.structures - std::min(stats.drawn, stats.structures);
+  stats.triangles = frame[Graphic3d_FrameStatsCounter_NbElemsTrianglesNotCulled];
+  stats.occluded = nbOccluded;
+  return stats;
+}
+
+void StaircaseViewController::initDrawingViewWorker(
+    std::function<void()> onResult) {
+  drawingWorker = std::make_unique<DrawingViewWorker>(onResult);
+}
+
+bool StaircaseViewController::showDrawingView(DrawingView direction) {
+  if (aisContext.IsNull() || !drawingWorker) { return false; }
+  if (partShapes.empty() ||
+      std::any_of(partShapes.begin(), partShapes.end(),
+                  [](TopoDS_Shape const &shape) { return shape.IsNull(); })) {
+    std::cout << "Drawing views need the BRep of the parts." << std::endl;
+    return false;
+  }
+
+  static std::map<DrawingView, V3d_TypeOfOrientation> const orientations = {
+      {DrawingView::Front, V3d_TypeOfOrientation_Zup_Front},
+      {DrawingView::Back, V3d_TypeOfOrientation_Zup_Back},
+      {DrawingView::Top, V3d_TypeOfOrientation_Zup_Top},
+      {DrawingView::Bottom, V3d_TypeOfOrientation_Zup_Bottom},
+      {DrawingView::Left, V3d_TypeOfOrientation_Zup_Left},
+      {DrawingView::Right, V3d_TypeOfOrientation_Zup_Right},
+      {DrawingView::Iso, V3d_TypeOfOrientation_Zup_AxoRight}};
+
+  myViewAnimation->Stop();
+  view->Camera()->SetProjectionType(Graphic3d_Camera::Projection_Orthographic);
+  view->SetProj(orientations.at(direction), false);
+  fitScene();
+  drawingView = direction;
+  drawingDirection = view->Camera()->Direction();
+  drawingUp = view->Camera()->Up();
+
+  auto cached = drawingCache.find(direction);
+  if (cached != drawingCache.end()) {
+    showDrawing(cached->second);
+  } else {
+    removeDrawing();
+    requestDrawing();
+  }
+  this->updateView();
+  return true;
+}
+
+void StaircaseViewController::hideDrawingView() {
+  if (!drawingView.has_value()) { return; }
+
+  drawingView.reset();
+  if (drawingWorker) { drawingWorker->cancel(); }
+  removeDrawing();
+  view->Camera()->SetProjectionType(Graphic3d_Camera::Projection_Perspective);
+  this->updateView();
+}
 
-  for (auto const &shape : shapes) {
+void StaircaseViewController::requestDrawing() {
+  std::vector<TopoDS_Shape> shapes;
+  for (size_t i = 0; i < partShapes.size(); ++i) {
+    if (partVisible[i]) { shapes.push_back(partShapes[i]); }
+  }
 
-    Handle(AIS_Shape) aisShape = new AIS_Shape(shape);
-    aisContext->SetDisplayMode(aisShape, AIS_SHADED_MODE, Standard_True);
-    aisContext->Display(aisShape, Standard_True);
+  // The drawing lies in the plane through the scene center, so it stays
+  // inside the depth range the view is fitted to.
+  Bnd_Box const bounds = sceneBounds.get();
+  gp_Pnt const origin =
+      bounds.IsVoid() ? gp_Pnt()
+                      : gp_Pnt((bounds.CornerMin().XYZ() +
+                                bounds.CornerMax().XYZ()) * 0.5);
+  gp_Dir const towardsViewer = drawingDirection.Reversed();
+  gp_Ax2 const frame(origin, towardsViewer, drawingUp.Crossed(towardsViewer));
+  drawingWorker->request(std::move(shapes), frame, int(drawingView.value()));
+}
+
+void StaircaseViewController::applyDrawingViewResult() {
+  if (!drawingWorker) { return; }
+  std::shared_ptr<DrawingViewWorker::Drawing const> drawing =
+      drawingWorker->takeResult();
+  if (!drawing || !drawingView.has_value() ||
+      drawing->direction != int(drawingView.value())) {
+    return;
+  }
+
+  drawingCache[drawingView.value()] = drawing;
+  showDrawing(drawing);
+  this->updateView();
+}
+
+void StaircaseViewController::showDrawing(
+    std::shared_ptr<DrawingViewWorker::Drawing const> const &drawing) {
+  removeDrawing();
+  activeDrawing = new StaircaseDrawing(drawing);
+  activeDrawing->SetZLayer(Graphic3d_ZLayerId_Topmost);
+  aisContext->Display(activeDrawing, AIS_WIREFRAME_MODE, -1, false);
+}
+
+void StaircaseViewController::removeDrawing() {
+  if (activeDrawing.IsNull()) { return; }
+  aisContext->Remove(activeDrawing, false);
+  activeDrawing.Nullify();
+}
+
+void StaircaseViewController::checkDrawingCamera() {
+  if (!drawingView.has_value()) { return; }
+
+  // Panning and zooming keep the drawing valid, turning does not.
+  Handle(Graphic3d_Camera) const &camera = view->Camera();
+  double const tolerance = Precision::Angular() * 10.0;
+  if (!camera->Direction().IsEqual(drawingDirection, tolerance) ||
+      !camera->Up().IsEqual(drawingUp, tolerance)) {
+    hideDrawingView();
+  }
+}
+
+int StaircaseViewController::addSectionPlane(gp_Pnt const &point,
+                                             gp_Dir const &normal) {
+  if (view.IsNull()) { return 0; }
+
+  Handle(Graphic3d_ClipPlane) plane = new Graphic3d_ClipPlane(gp_Pln(point, normal));
+  // Capping draws the cut solids once more through the stencil buffer, so
+  // no section geometry is ever built.
+  plane->SetCapping(true);
+  plane->SetUseObjectMaterial(true);
+  view->AddClipPlane(plane);
+
+  int const planeId = nextSectionPlaneId++;
+  sectionPlanes[planeId] = plane;
+  onSectionPlanesChanged();
+  return planeId;
+}
+
+bool StaircaseViewController::setSectionPlane(int planeId, gp_Pnt const &point,
+                                              gp_Dir const &normal) {
+  auto it = sectionPlanes.find(planeId);
+  if (it == sectionPlanes.end()) { return false; }
+
+  // Only the equation uniform changes.
+  it->second->SetEquation(gp_Pln(point, normal));
+  onSectionPlanesChanged();
+  return true;
+}
 
-    std::optional<Quantity_Color> optColor = getShapeColor(aDoc, shape);
+bool StaircaseViewController::removeSectionPlane(int planeId) {
+  auto it = sectionPlanes.find(planeId);
+  if (it == sectionPlanes.end()) { return false; }
 
-    if (optColor.has_value()) {
-      Quantity_Color aColor = optColor.value();
-      aisContext->SetColor(aisShape, aColor, Standard_True);
+  view->RemoveClipPlane(it->second);
+  sectionPlanes.erase(it);
+  onSectionPlanesChanged();
+  return true;
+}
+
+void StaircaseViewController::removeAllSectionPlanes() {
+  if (sectionPlanes.empty()) { return; }
+
+  for (auto const &[planeId, plane] : sectionPlanes) {
+    view->RemoveClipPlane(plane);
+  }
+  sectionPlanes.clear();
+  onSectionPlanesChanged();
+}
+
+void StaircaseViewController::onSectionPlanesChanged() {
+  if (hoverPicker) {
+    std::vector<Graphic3d_Vec4> equations;
+    for (auto const &[planeId, plane] : sectionPlanes) {
+      Graphic3d_Vec4d const &equation = plane->GetEquation();
+      equations.emplace_back(float(equation.x()), float(equation.y()),
+                             float(equation.z()), float(equation.w()));
     }
-    activeShapes.push_back(aisShape);
+    hoverPicker->setClipPlanes(std::move(equations));
   }
+  view->Invalidate();
+  this->updateView();
+}
 
-  this->FitAllAuto(aisContext, view);
+void StaircaseViewController::setOcclusionCulling(bool value) {
+  if (occlusionCulling == value) { return; }
+  occlusionCulling = value;
+  if (!value) {
+    for (auto &occludee : occludees) {
+      if (!occludee.isOccluded) { continue; }
+      occludee.isOccluded = false;
+      aisContext->SetViewAffinity(occludee.object, view, true);
+    }
+    nbOccluded = 0;
+  }
+  // Forces the next frame to rebuild the occlusion buffer.
+  occlusionViewProjection = Graphic3d_Mat4();
   this->updateView();
 }
 
+void StaircaseViewController::selectOccluders(
+    std::vector<StaircasePart> const &parts) {
+  clearOcclusion();
+
+  std::vector<size_t> bySize;
+  for (size_t i = 0; i < parts.size(); ++i) {
+    if (!parts[i].bounds.IsVoid() && !parts[i].mesh.IsNull()) {
+      bySize.push_back(i);
+    }
+  }
+  std::sort(bySize.begin(), bySize.end(), [&parts](size_t a, size_t b) {
+    return parts[a].bounds.SquareExtent() > parts[b].bounds.SquareExtent();
+  });
+
+  std::vector<bool> isOccluder(parts.size(), false);
+  size_t nbTriangles = 0;
+  for (size_t partIndex : bySize) {
+    if (occluders.size() == MAX_OCCLUDERS) { break; }
+    // The finest mesh that still fits: proxies are not conservative, and
+    // the coarser they are the further they bulge past the surface.
+    StaircasePart const &part = parts[partIndex];
+    Handle(Poly_Triangulation) occluder;
+    for (size_t level = 0; level <= part.lods.size(); ++level) {
+      Handle(Poly_Triangulation) const &candidate =
+          level == 0 ? part.mesh : part.lods[level - 1];
+      if (nbTriangles + candidate->NbTriangles() <= OCCLUDER_TRIANGLE_BUDGET) {
+        occluder = candidate;
+        break;
+      }
+    }
+    if (occluder.IsNull()) { continue; }
+    nbTriangles += occluder->NbTriangles();
+    occluders.push_back(occluder);
+    occluderParts.push_back(partIndex);
+    isOccluder[partIndex] = true;
+  }
+
+  // An object never tests against its own occluder mesh.
+  for (size_t i = 0; i < activeShapes.size(); ++i) {
+    if (isOccluder[i]) { continue; }
+    occludees.push_back({activeShapes[i], parts[i].bounds});
+  }
+  for (auto const &batch : activeBatches) {
+    Occludee occludee{batch, Bnd_Box()};
+    bool hasOccluder = false;
+    for (auto const &range : batch->getRanges()) {
+      hasOccluder = hasOccluder || isOccluder[range.partIndex];
+      occludee.bounds.Add(parts[range.partIndex].bounds);
+    }
+    if (!hasOccluder) { occludees.push_back(occludee); }
+  }
+  debugOut("occluders.size(): ", occluders.size(), " (", nbTriangles,
+           " triangles), occludees.size(): ", occludees.size());
+}
+
+void StaircaseViewController::updateOcclusion() {
+  if (!occlusionCulling || occluders.empty() || view.IsNull()) { return; }
+
+  Handle(Graphic3d_Camera) const &camera = view->Camera();
+  Graphic3d_Mat4 const viewProjection =
+      camera->ProjectionMatrixF() * camera->OrientationMatrixF();
+  if (std::equal(viewProjection.GetData(), viewProjection.GetData() + 16,
+                 occlusionViewProjection.GetData())) {
+    return;
+  }
+  occlusionViewProjection = viewProjection;
+
+  occlusionCuller.begin(viewProjection, windowSize.x(), windowSize.y());
+  for (size_t i = 0; i < occluders.size(); ++i) {
+    if (!partVisible[occluderParts[i]]) { continue; }
+    occlusionCuller.addOccluder(occluders[i]);
+  }
+
+  nbOccluded = 0;
+  for (auto &occludee : occludees) {
+    bool const isOccluded = occlusionCuller.isOccluded(occludee.bounds);
+    nbOccluded += isOccluded ? 1 : 0;
+    if (isOccluded == occludee.isOccluded) { continue; }
+    occludee.isOccluded = isOccluded;
+    aisContext->SetViewAffinity(occludee.object, view, !isOccluded);
+  }
+}
+
+void StaircaseViewController::clearOcclusion() {
+  occluders.clear();
+  occluderParts.clear();
+  occludees.clear();
+  nbOccluded = 0;
+  occlusionViewProjection = Graphic3d_Mat4();
+}
+
+std::vector<size_t> const &
+StaircaseViewController::partsOfNode(std::string const &nodeId) const {
+  static std::vector<size_t> const noParts;
+  auto const it = nodeParts.find(nodeId);
+  return it != nodeParts.end() ? it->second : noParts;
+}
+
+bool StaircaseViewController::setPartVisible(size_t partIndex, bool visible) {
+  if (partVisible[partIndex] == visible) { return false; }
+  partVisible[partIndex] = visible;
+  sceneBounds.setPartShown(partIndex, visible);
+  if (!activeEdges.IsNull()) { activeEdges->setPartVisible(partIndex, visible); }
+  if (int(partIndex) == hoveredPart) { clearHover(); }
+
+  if (!batchOfPart.empty()) {
+    // Batches not built yet pick the flag up in displayBatch.
+    size_t const batchIndex = batchOfPart[partIndex].first;
+    if (batchIndex < activeBatches.size()) {
+      activeBatches[batchIndex]->setPartVisible(partIndex, visible);
+    }
+  } else if (partIndex < activeShapes.size()) {
+    Handle(StaircaseShape) const &shape = activeShapes[partIndex];
+    if (!visible) {
+      aisContext->Erase(shape, false);
+    } else if (displayStyle != DisplayStyle::Wireframe) {
+      redisplay(shape);
+    }
+  }
+  return true;
+}
+
+void StaircaseViewController::onVisibilityChanged() {
+  if (hoverPickerHasScene) {
+    std::vector<bool> hidden(partVisible.size());
+    for (size_t i = 0; i < partVisible.size(); ++i) {
+      hidden[i] = !partVisible[i];
+    }
+    hoverPicker->setHiddenParts(std::move(hidden));
+  }
+  // Hidden occluders stop occluding on the next frame.
+  occlusionViewProjection = Graphic3d_Mat4();
+  drawingCache.clear();
+  if (drawingView.has_value()) { requestDrawing(); }
+  // Batch and edge buffers changed in place, which no structure reports.
+  view->Invalidate();
+  this->updateView();
+}
+
+size_t StaircaseViewController::setVisible(std::string const &nodeId,
+                                           bool visible) {
+  return setNodesVisible({nodeId}, visible);
+}
+
+size_t
+StaircaseViewController::setNodesVisible(std::vector<std::string> const &nodeIds,
+                                         bool visible) {
+  if (aisContext.IsNull()) { return 0; }
+
+  size_t nbChanged = 0;
+  for (auto const &nodeId : nodeIds) {
+    for (size_t partIndex : partsOfNode(nodeId)) {
+      nbChanged += setPartVisible(partIndex, visible) ? 1 : 0;
+    }
+  }
+  if (nbChanged > 0) { onVisibilityChanged(); }
+  return nbChanged;
+}
+
+size_t StaircaseViewController::setAllVisible(bool visible) {
+  if (aisContext.IsNull()) { return 0; }
+
+  size_t nbChanged = 0;
+  for (size_t i = 0; i < partVisible.size(); ++i) {
+    nbChanged += setPartVisible(i, visible) ? 1 : 0;
+  }
+  if (nbChanged > 0) { onVisibilityChanged(); }
+  return nbChanged;
+}
+
+bool StaircaseViewController::isVisible(std::string const &nodeId) const {
+  // A node counts as visible while any part below it is.
+  for (size_t partIndex : partsOfNode(nodeId)) {
+    if (partVisible[partIndex]) { return true; }
+  }
+  return false;
+}
+
+std::vector<std::string> StaircaseViewController::getNodeIds() const {
+  std::vector<std::string> nodeIds;
+  nodeIds.reserve(nodeParts.size());
+  for (auto const &[entry, partIndices] : nodeParts) {
+    nodeIds.push_back(entry);
+  }
+  return nodeIds;
+}
+
+void StaircaseViewController::setLargeModelMode(bool value) {
+  largeModelMode = value;
+}
+
+bool StaircaseViewController::isLargeModelMode() const {
+  return largeModelMode;
+}
+
+void StaircaseViewController::setCompactVertexFormat(bool value) {
+  compactVertexFormat = value;
+  if (aisContext.IsNull()) { return; }
+
+  for (auto const &shape : activeShapes) {
+    if (shape->hasCompactVertices() == value) { continue; }
+    // The compact child joins or leaves the shape while it is erased, and
+    // is displayed along with it.
+    bool const isShown = aisContext->IsDisplayed(shape);
+    if (isShown) { aisContext->Erase(shape, false); }
+    shape->setCompactVertices(value);
+    if (isShown) { redisplay(shape); }
+    aisContext->Update(shape, false);
+  }
+  this->updateView();
+}
+
+void StaircaseViewController::selectNavigationLod() {
+  navigationLod = -1;
+
+  auto totalTriangles = [this](int lodLevel) {
+    size_t total = 0;
+    for (auto const &shape : activeShapes) {
+      total += shape->nbTriangles(lodLevel);
+    }
+    return total;
+  };
+
+  if (totalTriangles(-1) <= LOD_TRIANGLE_BUDGET) { return; }
+
+  int const nbLevels = static_cast<int>(LOD_RATIOS.size());
+  for (navigationLod = 0; navigationLod < nbLevels - 1; ++navigationLod) {
+    if (totalTriangles(navigationLod) <= LOD_TRIANGLE_BUDGET) { break; }
+  }
+  debugOut("navigationLod: ", navigationLod);
+}
+
+bool StaircaseViewController::isNavigating() const {
+  switch (myMouseActiveGesture) {
+  case AIS_MouseGesture_Zoom:
+  case AIS_MouseGesture_Pan:
+  case AIS_MouseGesture_RotateOrbit:
+  case AIS_MouseGesture_RotateView: return true;
+  default: break;
+  }
+  return myGL.Panning.ToPan || myGL.OrbitRotation.ToRotate ||
+         myGL.ViewRotation.ToRotate || myGL.ZRotate.ToRotate ||
+         !myGL.ZoomActions.IsEmpty() ||
+         (!myViewAnimation.IsNull() && !myViewAnimation->IsStopped());
+}
+
+// Swaps proxies in while the camera moves and full meshes back once it has
+// rested for LOD_IDLE_DELAY. Returns true while waiting for that delay.
+bool StaircaseViewController::updateNavigationLod() {
+  if (navigationLod < 0) { return false; }
+
+  auto const now = std::chrono::steady_clock::now();
+  if (isNavigating()) {
+    lastNavigationTime = now;
+    if (!showingNavigationLod) { showNavigationLod(true); }
+    return false;
+  }
+  if (!showingNavigationLod) { return false; }
+  if (now - lastNavigationTime < LOD_IDLE_DELAY) { return true; }
+
+  showNavigationLod(false);
+  return false;
+}
+
+void StaircaseViewController::showNavigationLod(bool toShow) {
+  showingNavigationLod = toShow;
+  Standard_Integer const mode =
+      toShow ? AIS_LOD_MODE + navigationLod : AIS_SHADED_MODE;
+  for (auto const &shape : activeShapes) {
+    aisContext->SetDisplayMode(shape, mode, false);
+  }
+  view->Invalidate();
+}
+
+void StaircaseViewController::handleViewRedraw(
+    Handle(AIS_InteractiveContext) const &theCtx,
+    Handle(V3d_View) const &theView) {
+  bool const toWaitForIdle = updateNavigationLod();
+  updateOcclusion();
+  checkDrawingCamera();
+  AIS_ViewController::handleViewRedraw(theCtx, theView);
+  if (toWaitForIdle) { setAskNextFrame(); }
+
+  // Keep drawing frames while an animation or the LOD idle delay needs them.
+  if (myToAskNextFrame) { ProcessInput(); }
+}
+
 void StaircaseViewController::setCanLoadNewFile(bool value) {
   std::lock_guard<std::mutex> lock(fileLoadMutex);
   _canLoadNewFile = value;
@@ -265,12 +1428,21 @@ bool StaircaseViewController::canLoadNewFile() {
   return _canLoadNewFile;
 }
 
+void StaircaseViewController::setSuspended(bool value) {
+  if (value == isSuspended) { return; }
+  isSuspended = value;
+  if (isSuspended) {
+    FramePump::instance().cancel(this);
+  } else {
+    updateView();
+  }
+}
+
 void StaircaseViewController::ProcessInput() {
-  if (shouldRender && !view.IsNull()) {
-    // Schedule canvas redraw post user input, aligned with animation frame.
-    if (++updateRequestCount == 1) {
-      emscripten_async_call(onRedrawView, this, -1);
-    }
+  if (shouldRender && !isSuspended && !view.IsNull()) {
+    // Redraw on the next frame of the shared pump, once however many
+    // inputs and updates arrive before it.
+    FramePump::instance().requestFrame(this, onRedrawView);
   }
 }
 
@@ -287,21 +1459,31 @@ void StaircaseViewController::updateView() {
 
 void StaircaseViewController::redrawView() {
   if (!view.IsNull()) {
-    updateRequestCount = 0;
     FlushViewEvents(aisContext, view, true);
   }
-  setCanLoadNewFile(true);
+  // The scene builder reads the loaded parts until it is done.
+  setCanLoadNewFile(!isBuildingScene());
 }
 
 void StaircaseViewController::fitAllObjects(bool withAuto) {
-  if (withAuto) {
+  // Only fitting the selection needs the presentations' own bounds.
+  if (withAuto && aisContext->NbSelected() > 0) {
     this->FitAllAuto(aisContext, view);
   } else {
-    view->FitAll(0.01, false);
+    fitScene();
   }
   this->updateView();
 }
 
+void StaircaseViewController::fitScene() {
+  Bnd_Box const bounds = sceneBounds.get();
+  if (bounds.IsVoid()) {
+    view->FitAll(0.01, false);
+  } else {
+    view->FitAll(bounds, 0.01, false);
+  }
+}
+
 EM_BOOL
 StaircaseViewController::onMouseEvent(int eventType,
                                       EmscriptenMouseEvent const *event) {
@@ -309,10 +1491,11 @@ StaircaseViewController::onMouseEvent(int eventType,
   auto aWindow = Handle(Wasm_Window)::DownCast(view->Window());
   if (eventType == EMSCRIPTEN_EVENT_MOUSEMOVE ||
       eventType == EMSCRIPTEN_EVENT_MOUSEUP) {
-    jsUpdateBoundingClientRect();
+    int offset[2];
+    jsGetCanvasOffset(canvasId.c_str(), offset);
     EmscriptenMouseEvent anEvent = *event;
-    anEvent.targetX -= jsGetBoundingClientLeft();
-    anEvent.targetY -= jsGetBoundingClientTop();
+    anEvent.targetX -= offset[0];
+    anEvent.targetY -= offset[1];
     aWindow->ProcessMouseEvent(*this, eventType, &anEvent);
     return EM_FALSE;
   }
@@ -415,7 +1598,7 @@ void StaircaseViewController::KeyUp(Aspect_VKey theKey, double theTime) {
 bool StaircaseViewController::processKeyPress(Aspect_VKey theKey) {
   switch (theKey) {
   case Aspect_VKey_F: {
-    view->FitAll(0.01, false);
+    fitScene();
     this->updateView();
     return true;
   }
@@ -1,21 +1,42 @@
 #ifndef STAIRCASEVIEWCONTROLLER_HPP
 #define STAIRCASEVIEWCONTROLLER_HPP
+#include "BvhPrebuilder.hpp"
+#include "DrawingViewWorker.hpp"
+#include "FramePump.hpp"
+#include "HoverPicker.hpp"
+#include "InputDispatcher.hpp"
+#include "OcclusionCuller.hpp"
+#include "SceneBounds.hpp"
+#include "StaircaseBatch.hpp"
+#include "StaircaseDrawing.hpp"
+#include "StaircaseEdges.hpp"
+#include "StaircasePart.hpp"
+#include "StaircaseShape.hpp"
 #include <AIS_ViewController.hxx>
+#include <chrono>
+#include <map>
+#include <memory>
 #include <emscripten.h>
 #include <emscripten/bind.h>
 #include <emscripten/html5.h>
 #include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <opencascade/AIS_Shape.hxx>
 #include <opencascade/AIS_ViewCube.hxx>
 #include <opencascade/Prs3d_TextAspect.hxx>
 #include <opencascade/TDocStd_Document.hxx>
 #include <opencascade/Aspect_VKey.hxx>
+#include <opencascade/Graphic3d_ClipPlane.hxx>
+
+enum class DisplayStyle { Shaded, Wireframe, ShadedWithEdges };
+enum class DrawingView { Front, Back, Top, Bottom, Left, Right, Iso };
 
 class StaircaseViewController : protected AIS_ViewController {
 public:
   StaircaseViewController(std::string const &canvasId)
-      : canvasId(canvasId), devicePixelRatio(1), updateRequestCount(0) {}
-  virtual ~StaircaseViewController() {}
+      : canvasId(canvasId), devicePixelRatio(1) {}
+  virtual ~StaircaseViewController();
   void initWindow();
   bool initViewer();
   void initPixelScaleRatio();
@@ -24,7 +45,130 @@ public:
   void updateView();
   void fitAllObjects(bool withAuto);
   void removeAllObjects();
-  void initStepFile(Handle(TDocStd_Document) aDoc);
+  struct SceneBuildStats {
+    size_t partsTotal = 0;
+    size_t partsAdded = 0;
+    size_t frames = 0;
+    size_t lastFrameParts = 0;
+    size_t maxFrameParts = 0;
+    double lastFrameMs = 0.0;
+    double totalMs = 0.0;
+    bool done = false;
+  };
+
+  // Starts populating the scene with `parts`, which must stay alive until
+  // continueStepFile returns true. `nodes` backs the node ids of setVisible.
+  void initStepFile(std::vector<StaircasePart> const &parts,
+                    Handle(Graphic3d_ArrayOfSegments) const &edges,
+                    StaircaseNodeParts const &nodes);
+  // Adds parts until the scene build budget is spent or `turnEnd` is reached,
+  // whichever comes first. Returns true once every part is displayed.
+  bool continueStepFile(std::chrono::steady_clock::time_point turnEnd =
+                            std::chrono::steady_clock::time_point::max());
+  bool isBuildingScene() const;
+  void setSceneBuildBudget(double milliseconds);
+  SceneBuildStats const &getSceneBuildStats() const;
+  void setDisplayStyle(DisplayStyle style);
+  // Draws shapes from 8 byte vertices with a shader of their own. That shader
+  // lights with a fixed two-sided headlight and the flat object color: it
+  // ignores the view's lights, the material and specular highlights, so
+  // compact parts look flatter than edges, highlights and batches next to
+  // them.
+  void setCompactVertexFormat(bool value);
+  struct CullingStats {
+    size_t structures = 0;
+    size_t drawn = 0;
+    size_t culled = 0;
+    size_t triangles = 0;
+    size_t occluded = 0;
+  };
+
+  // Parts that project smaller than this many pixels are skipped; 0 turns
+  // size culling off.
+  void setCullingSize(int pixels);
+  // Counts of the last drawn frame.
+  CullingStats getCullingStats() const;
+  struct SelectionStats {
+    size_t objects = 0;
+    size_t activated = 0;
+    size_t activatedOnDemand = 0;
+    double activationMs = 0.0;
+  };
+
+  // Computes the sensitive entities of a few more objects within the idle
+  // budget and hands them to the BvhPrebuilder, stopping at `turnEnd` if that
+  // comes first. Returns true once every object is active or queued.
+  bool continueSelectionActivation(
+      std::chrono::steady_clock::time_point turnEnd =
+          std::chrono::steady_clock::time_point::max());
+  SelectionStats const &getSelectionStats() const;
+
+  struct PickingBenchmark {
+    size_t entities = 0;
+    size_t triangles = 0;
+    double activationMs = 0.0;
+    double linearBuildMs = 0.0;
+    double binnedBuildMs = 0.0;
+    double pooledBuildMs = 0.0;
+    double pickMs = 0.0; // average per pick
+  };
+
+  // Activates every selection, then times BVH builds of the sensitive sets
+  // of active objects with each builder and `nbPicks` picks spread over the
+  // view. Objects in the BvhPrebuilder's queue are skipped.
+  PickingBenchmark benchmarkPicking(int nbPicks);
+
+  // Builds picking BVHs on the TaskPool. `onBuilt` is called from a pool
+  // thread whenever applyPrebuiltSelections has objects to activate.
+  void initBvhPrebuilder(std::function<void()> onBuilt);
+  void applyPrebuiltSelections();
+
+  // Runs hover detection as HoverPicker jobs on the TaskPool. `onResult` is
+  // called from a pool thread whenever applyHoverResult has something to
+  // apply.
+  void initHoverPicker(std::function<void()> onResult);
+  void setOffThreadHover(bool value);
+  void applyHoverResult();
+
+  // Shows or hides the parts below an XCAF node: the part read from its
+  // label, and for assemblies and components the parts of the shapes they
+  // reference. Node ids are label entries such as "0:1:1:2". The
+  // presentations are kept, so nothing is recomputed. Returns the number of
+  // parts changed.
+  size_t setVisible(std::string const &nodeId, bool visible);
+  size_t setNodesVisible(std::vector<std::string> const &nodeIds, bool visible);
+  size_t setAllVisible(bool visible);
+  bool isVisible(std::string const &nodeId) const;
+  std::vector<std::string> getNodeIds() const;
+
+  // Hidden line drawings are computed on a DrawingViewWorker thread.
+  // `onResult` is called from that thread when applyDrawingViewResult has a
+  // drawing to show.
+  void initDrawingViewWorker(std::function<void()> onResult);
+  // Turns the camera to `direction` with a parallel projection and overlays
+  // the visible and hidden edges of the visible parts once computed. The
+  // drawing goes away when the camera turns. Returns false when the parts
+  // have no BRep to project, as in mesh-only mode.
+  bool showDrawingView(DrawingView direction);
+  void hideDrawingView();
+  void applyDrawingViewResult();
+
+  // Section planes through a point with the normal pointing to the side
+  // that is kept. Cut solids are capped with their own material. Moving a
+  // plane only changes its equation, nothing is recomputed.
+  int addSectionPlane(gp_Pnt const &point, gp_Dir const &normal);
+  bool setSectionPlane(int planeId, gp_Pnt const &point, gp_Dir const &normal);
+  bool removeSectionPlane(int planeId);
+  void removeAllSectionPlanes();
+
+  // Stops redrawing while the canvas cannot be seen. Resuming draws one
+  // frame with everything that changed meanwhile.
+  void setSuspended(bool value);
+
+  // Hides objects behind the largest parts with a CPU occlusion pass.
+  void setOcclusionCulling(bool value);
+  void setLargeModelMode(bool value);
+  bool isLargeModelMode() const;
   char const *getCanvasTag();
   EM_BOOL onMouseEvent(int eventType, EmscriptenMouseEvent const *event);
   EM_BOOL onWheelEvent(int eventType, EmscriptenWheelEvent const *event);
@@ -48,18 +192,30 @@ public:
   void setAISContext(Handle(AIS_InteractiveContext) const &aisContext);
 
   bool shouldRender;
-  std::vector<Handle(AIS_Shape)> activeShapes;
+  std::vector<Handle(StaircaseShape)> activeShapes;
+  std::vector<Handle(StaircaseBatch)> activeBatches;
+  Handle(StaircaseEdges) activeEdges;
   Graphic3d_Vec2i const &getWindowSize() const;
 
   void setCanLoadNewFile(bool value);
   bool canLoadNewFile();
   double cubeSize;
+
+protected:
+  virtual void handleViewRedraw(Handle(AIS_InteractiveContext) const &theCtx,
+                                Handle(V3d_View) const &theView) override;
+  virtual void
+  handleDynamicHighlight(Handle(AIS_InteractiveContext) const &theCtx,
+                         Handle(V3d_View) const &theView) override;
+  virtual void
+  handleSelectionPick(Handle(AIS_InteractiveContext) const &theCtx,
+                      Handle(V3d_View) const &theView) override;
+
 private:
   std::string canvasId;
   std::string prefixedCanvasId;
 
   float devicePixelRatio;
-  unsigned int updateRequestCount;
   Graphic3d_Vec2i windowSize;
 
   Handle(AIS_InteractiveContext) aisContext;
@@ -71,6 +227,139 @@ private:
   bool _canLoadNewFile;
 
   NCollection_DataMap<unsigned int, Aspect_VKey> navKeyMap;
+  bool compactVertexFormat = false;
+
+  // Draw parts merged into one StaircaseBatch per color instead of one
+  // AIS_Shape each.
+  bool largeModelMode = false;
+
+  DisplayStyle displayStyle = DisplayStyle::Shaded;
+  int cullingSize = 2;
+
+  // Proxy level drawn while the camera moves, or -1 when the full model is
+  // cheap enough to navigate as is.
+  int navigationLod = -1;
+  bool showingNavigationLod = false;
+  std::chrono::steady_clock::time_point lastNavigationTime;
+
+  // Scene being populated by continueStepFile, one frame budget at a time.
+  // pendingBatches holds the part indices of each color batch still to be
+  // built, and stays empty when parts are displayed as individual shapes.
+  std::vector<StaircasePart> const *pendingParts = nullptr;
+  std::vector<std::vector<size_t>> pendingBatches;
+  size_t nextPending = 0;
+  std::chrono::microseconds sceneBuildBudget{8000};
+  std::chrono::steady_clock::time_point sceneBuildStart;
+  SceneBuildStats sceneBuildStats;
+
+  // Largest parts, drawn into the occlusion buffer with their coarsest mesh,
+  // and the objects tested against it. Occluded objects are hidden through
+  // their view affinity, which is independent of what the user shows.
+  struct Occludee {
+    Handle(AIS_InteractiveObject) object;
+    Bnd_Box bounds;
+    bool isOccluded = false;
+  };
+  bool occlusionCulling = false;
+  OcclusionCuller occlusionCuller;
+  std::vector<Handle(Poly_Triangulation)> occluders;
+  std::vector<size_t> occluderParts;
+  std::vector<Occludee> occludees;
+  Graphic3d_Mat4 occlusionViewProjection;
+  size_t nbOccluded = 0;
+
+  void selectOccluders(std::vector<StaircasePart> const &parts);
+  void updateOcclusion();
+  void clearOcclusion();
+
+  // Objects are displayed without selection modes. Their sensitive
+  // entities are only built once the cursor ray first crosses their bounds,
+  // or by the idle activation that follows the scene build. The latter
+  // leaves the BVHs to the prebuilder and activates the object when they
+  // are done.
+  struct Selectable {
+    Handle(AIS_InteractiveObject) object;
+    Bnd_Box bounds;
+    bool isActive = false;
+    bool isPrebuilding = false;
+  };
+  std::vector<Selectable> selectables;
+  std::unordered_map<AIS_InteractiveObject const *, size_t> selectableIndices;
+  size_t nextIdleSelectable = 0;
+  SelectionStats selectionStats;
+
+  void addSelectable(Handle(AIS_InteractiveObject) const &object,
+                     Bnd_Box const &bounds);
+  // Displays an erased object again, with the selection it had.
+  void redisplay(Handle(AIS_InteractiveObject) const &object);
+  void activateSelection(Selectable &selectable, bool isOnDemand);
+  void activateSelectionAt(Graphic3d_Vec2i const &point);
+  void activateAllSelections();
+  void prebuildSelection(Selectable &selectable);
+  std::unique_ptr<BvhPrebuilder> bvhPrebuilder;
+
+  // Hover pipeline: at most one ray per frame goes to the picker, and its
+  // answer is applied when it arrives. `batchOfPart` maps a part to its batch
+  // and range in large-model mode.
+  std::unique_ptr<HoverPicker> hoverPicker;
+  bool offThreadHover = true;
+  bool isSuspended = false;
+  bool hoverPickerHasScene = false;
+  Graphic3d_Vec2i hoverPoint;
+  int hoveredPart = -1;
+  Handle(AIS_InteractiveObject) hoveredShape;
+  Handle(StaircaseBatchOwner) hoveredOwner;
+  std::vector<std::pair<size_t, size_t>> batchOfPart;
+
+  void setHoverScene(std::vector<StaircasePart> const &parts);
+  void clearHover();
+
+  // Parts below every node, mapped on the worker. `partVisible` holds the
+  // user's choice, which the display style and occlusion culling never
+  // change.
+  StaircaseNodeParts nodeParts;
+  std::vector<bool> partVisible;
+
+  std::vector<size_t> const &partsOfNode(std::string const &nodeId) const;
+  bool setPartVisible(size_t partIndex, bool visible);
+  void onVisibilityChanged();
+
+  // Drawing view state. Drawings are cached per direction until the
+  // document or the visible parts change; `drawingDirection` and `drawingUp`
+  // are the camera orientation the current drawing belongs to.
+  std::unique_ptr<DrawingViewWorker> drawingWorker;
+  std::vector<TopoDS_Shape> partShapes;
+  std::map<DrawingView, std::shared_ptr<DrawingViewWorker::Drawing const>>
+      drawingCache;
+  std::optional<DrawingView> drawingView;
+  gp_Dir drawingDirection;
+  gp_Dir drawingUp;
+  Handle(StaircaseDrawing) activeDrawing;
+
+  void requestDrawing();
+  void showDrawing(std::shared_ptr<DrawingViewWorker::Drawing const> const &drawing);
+  void removeDrawing();
+  void checkDrawingCamera();
+
+  std::map<int, Handle(Graphic3d_ClipPlane)> sectionPlanes;
+  int nextSectionPlaneId = 1;
+
+  void onSectionPlanesChanged();
+
+  // Bounds of the displayed parts, used for every fit instead of the
+  // bounding boxes of all presentations.
+  SceneBounds sceneBounds;
+
+  void fitScene();
+
+  void displayShape(StaircasePart const &part);
+  void displayBatch(std::vector<StaircasePart> const &parts,
+                    std::vector<size_t> const &partIndices);
+  void applyDisplayStyle();
+  void selectNavigationLod();
+  bool isNavigating() const;
+  bool updateNavigationLod();
+  void showNavigationLod(bool toShow);
 
   double determineCubeSize(double width, double height);
 
@@ -1,11 +1,14 @@
 #include "StaircaseViewer.hpp"
 #include "GraphicsUtilities.hpp"
 #include "OCCTUtilities.hpp"
+#include "TaskPool.hpp"
+#include <algorithm>
 #include <atomic>
 #include <emscripten/threading.h>
 #include <memory>
 #include <opencascade/Standard_Version.hxx>
 #include <optional>
+#include <thread>
 
 #ifndef DIST_BUILD
 #include "EmbeddedStepFile.hpp"
@@ -53,6 +56,7 @@ StaircaseViewer::StaircaseViewer(std::string const &containerId) {
   }
 
   context = std::make_shared<ViewerContext>();
+  context->setMessageHandler(handleMessages);
   context->containerId = containerId;
   context->canvasId = "staircase-canvas-" + generate_uuid();
   debugOut("context->canvasId: " + context->canvasId);
@@ -67,10 +71,18 @@ StaircaseViewer::StaircaseViewer(std::string const &containerId) {
   context->viewController->initWindow();
   context->webGLContext = setupWebGLContext(context->canvasId);
   context->viewController->initViewer();
-
-  context->pushMessage(MessageType::NextFrame); // kick off event loop
-  emscripten_async_run_in_main_runtime_thread(EM_FUNC_SIG_VI, handleMessages,
-                                              context.get());
+  context->viewController->initHoverPicker(
+      [context = context.get()]() {
+        context->pushMessage({MessageType::HoverResult});
+      });
+  context->viewController->initDrawingViewWorker(
+      [context = context.get()]() {
+        context->pushMessage({MessageType::DrawingViewResult});
+      });
+  context->viewController->initBvhPrebuilder(
+      [context = context.get()]() {
+        context->pushMessage({MessageType::SelectionPrebuilt});
+      });
 
   StaircaseViewer::ensureBackgroundWorker();
 }
@@ -119,7 +131,7 @@ EMSCRIPTEN_KEEPALIVE std::string StaircaseViewer::getOCCTVersion() {
 
 EMSCRIPTEN_KEEPALIVE void StaircaseViewer::initEmptyScene() {
   context->pushMessage(
-      *chain(MessageType::ClearScreen, MessageType::ClearScreen,
+      chain(MessageType::ClearScreen, MessageType::ClearScreen,
              MessageType::ClearScreen, MessageType::InitEmptyScene,
              MessageType::NextFrame));
 }
@@ -144,7 +156,8 @@ StaircaseViewer::loadStepFile(std::string const &stepFileContent) {
   }
   setStepFileContent(stepFileContent);
 
-  Staircase::Message message(MessageType::LoadStepFile, this);
+  Staircase::Message message(MessageType::LoadStepFile,
+                             Staircase::LoadStepFilePayload{this});
   StaircaseViewer::pushBackground(message);
   StaircaseViewer::ensureBackgroundWorker();
 
@@ -234,15 +247,18 @@ void *StaircaseViewer::_loadStepFile(void *arg) {
   context->showingSpinner = true;
   context->pushMessage({MessageType::DrawLoadingScreen});
 
+  bool const meshOnly = context->meshOnlyMode;
+  size_t heapBeforeRelease = 0;
+
   // Read STEP file and handle the result in the callback
   readStepFile(XCAFApp_Application::GetApplication(),
                viewer->getStepFileContent(),
-               [&context](std::optional<Handle(TDocStd_Document)> docOpt) {
+               [&](std::optional<Handle(TDocStd_Document)> docOpt) {
                  if (!docOpt.has_value()) {
                    std::cerr << "Failed to read STEP file: DocHandle is empty"
                              << std::endl;
                    context->showingSpinner = false;
-                   context->pushMessage(*chain(
+                   context->pushMessage(chain(
                        MessageType::ClearScreen, MessageType::ClearScreen,
                        MessageType::ClearScreen, MessageType::InitEmptyScene,
                        MessageType::NextFrame));
@@ -250,15 +266,38 @@ void *StaircaseViewer::_loadStepFile(void *arg) {
                  }
                  auto aDoc = docOpt.value();
                  std::cout << "STEP File Loaded!" << std::endl;
-                 context->showingSpinner = false;
                  context->currentlyViewingDoc = aDoc;
+                 {
+                   Timer timer = Timer("prepareParts(aDoc)");
+                   context->loadedParts = prepareParts(aDoc);
+                   context->loadedNodes =
+                       mapNodeParts(aDoc, context->loadedParts);
+                   context->loadedEdges = packEdges(context->loadedParts);
+                 }
+                 if (meshOnly) {
+                   heapBeforeRelease = heapBytesInUse();
+                   context->currentlyViewingDoc.Nullify();
+                   releaseDocument(XCAFApp_Application::GetApplication(), aDoc,
+                                   context->loadedParts);
+                   viewer->setStepFileContent("");
+                 }
+                 context->showingSpinner = false;
 
                  context->pushMessage(
-                     *chain(MessageType::ClearScreen, MessageType::ClearScreen,
+                     chain(MessageType::ClearScreen, MessageType::ClearScreen,
                             MessageType::ClearScreen, MessageType::InitStepFile,
                             MessageType::NextFrame));
                });
 
+  // The reader and the copies of the file content are gone once
+  // readStepFile returns, so the savings are measured here.
+  if (heapBeforeRelease != 0) {
+    size_t const heapAfterRelease = heapBytesInUse();
+    std::cout << "[HEAP] " << heapBeforeRelease / 1024 << " KiB before, "
+              << heapAfterRelease / 1024 << " KiB after releasing the document"
+              << std::endl;
+  }
+
   return nullptr;
 }
 
@@ -270,12 +309,250 @@ void StaircaseViewer::removeAllObjects() {
   context->viewController->removeAllObjects();
 }
 
-std::atomic<bool> isHandlingMessages{false};
+void StaircaseViewer::setCompactVertexFormat(bool value) {
+  context->viewController->setCompactVertexFormat(value);
+}
+
+void StaircaseViewer::setLargeModelMode(bool value) {
+  if (context->viewController->isLargeModelMode() == value) { return; }
+  context->viewController->setLargeModelMode(value);
+
+  // Rebuild the scene of an already loaded file in the new mode. While a
+  // file loads, the worker owns the loaded parts; the InitStepFile it sends
+  // picks up the new mode. A scene being built restarts.
+  if (!context->canLoadNewFile() &&
+      !context->viewController->isBuildingScene()) {
+    return;
+  }
+  if (!context->loadedParts.empty()) {
+    context->pushMessage({MessageType::InitStepFile});
+  }
+}
+
+void StaircaseViewer::setDisplayStyle(DisplayStyle style) {
+  context->viewController->setDisplayStyle(style);
+}
+
+void StaircaseViewer::setSceneBuildBudget(double milliseconds) {
+  context->viewController->setSceneBuildBudget(milliseconds);
+}
+
+emscripten::val StaircaseViewer::getSceneBuildStats() {
+  auto const &stats = context->viewController->getSceneBuildStats();
+  emscripten::val result = emscripten::val::object();
+  result.set("partsTotal", stats.partsTotal);
+  result.set("partsAdded", stats.partsAdded);
+  result.set("frames", stats.frames);
+  result.set("lastFrameParts", stats.lastFrameParts);
+  result.set("maxFrameParts", stats.maxFrameParts);
+  result.set("lastFrameMs", stats.lastFrameMs);
+  result.set("totalMs", stats.totalMs);
+  result.set("done", stats.done);
+  return result;
+}
+
+void StaircaseViewer::setCullingSize(int pixels) {
+  context->viewController->setCullingSize(pixels);
+}
+
+emscripten::val StaircaseViewer::getCullingStats() {
+  auto const stats = context->viewController->getCullingStats();
+  emscripten::val result = emscripten::val::object();
+  result.set("structures", stats.structures);
+  result.set("drawn", stats.drawn);
+  result.set("culled", stats.culled);
+  result.set("triangles", stats.triangles);
+  result.set("occluded", stats.occluded);
+  return result;
+}
+
+emscripten::val StaircaseViewer::getSelectionStats() {
+  auto const &stats = context->viewController->getSelectionStats();
+  emscripten::val result = emscripten::val::object();
+  result.set("objects", stats.objects);
+  result.set("activated", stats.activated);
+  result.set("activatedOnDemand", stats.activatedOnDemand);
+  result.set("activationMs", stats.activationMs);
+  return result;
+}
+
+emscripten::val StaircaseViewer::benchmarkPicking(int nbPicks) {
+  auto const stats = context->viewController->benchmarkPicking(nbPicks);
+  emscripten::val result = emscripten::val::object();
+  result.set("entities", stats.entities);
+  result.set("triangles", stats.triangles);
+  result.set("activationMs", stats.activationMs);
+  result.set("linearBuildMs", stats.linearBuildMs);
+  result.set("binnedBuildMs", stats.binnedBuildMs);
+  result.set("pooledBuildMs", stats.pooledBuildMs);
+  result.set("pickMs", stats.pickMs);
+  return result;
+}
+
+void StaircaseViewer::setOffThreadHover(bool value) {
+  context->viewController->setOffThreadHover(value);
+}
+
+void StaircaseViewer::setSuspended(bool value) {
+  context->setSuspended(value);
+  context->viewController->setSuspended(value);
+}
+
+size_t StaircaseViewer::setVisible(std::string const &nodeId, bool visible) {
+  return context->viewController->setVisible(nodeId, visible);
+}
+
+size_t StaircaseViewer::setNodesVisible(emscripten::val const &nodeIds,
+                                        bool visible) {
+  return context->viewController->setNodesVisible(
+      emscripten::vecFromJSArray<std::string>(nodeIds), visible);
+}
+
+size_t StaircaseViewer::setAllVisible(bool visible) {
+  return context->viewController->setAllVisible(visible);
+}
+
+bool StaircaseViewer::isVisible(std::string const &nodeId) {
+  return context->viewController->isVisible(nodeId);
+}
+
+emscripten::val StaircaseViewer::getNodeIds() {
+  return emscripten::val::array(context->viewController->getNodeIds());
+}
+
+bool StaircaseViewer::showDrawingView(DrawingView direction) {
+  return context->viewController->showDrawingView(direction);
+}
+
+void StaircaseViewer::hideDrawingView() {
+  context->viewController->hideDrawingView();
+}
+
+int StaircaseViewer::addSectionPlane(double x, double y, double z, double nx,
+                                     double ny, double nz) {
+  if (gp_Vec(nx, ny, nz).SquareMagnitude() == 0.0) { return 0; }
+  return context->viewController->addSectionPlane(gp_Pnt(x, y, z),
+                                                  gp_Dir(nx, ny, nz));
+}
+
+bool StaircaseViewer::setSectionPlane(int planeId, double x, double y, double z,
+                                      double nx, double ny, double nz) {
+  if (gp_Vec(nx, ny, nz).SquareMagnitude() == 0.0) { return false; }
+  return context->viewController->setSectionPlane(planeId, gp_Pnt(x, y, z),
+                                                  gp_Dir(nx, ny, nz));
+}
+
+bool StaircaseViewer::removeSectionPlane(int planeId) {
+  return context->viewController->removeSectionPlane(planeId);
+}
+
+void StaircaseViewer::removeAllSectionPlanes() {
+  context->viewController->removeAllSectionPlanes();
+}
+
+emscripten::val StaircaseViewer::getFrameStats() {
+  auto const &stats = FramePump::instance().getStats();
+  emscripten::val result = emscripten::val::object();
+  result.set("frames", stats.frames);
+  result.set("lastFrameMs", stats.lastFrameMs);
+  result.set("maxFrameMs", stats.maxFrameMs);
+  result.set("averageFrameMs", stats.averageFrameMs);
+  result.set("lastIntervalMs", stats.lastIntervalMs);
+  result.set("lastCallbacks", stats.lastCallbacks);
+  return result;
+}
+
+emscripten::val StaircaseViewer::benchmarkMessageQueue(int nbMessages) {
+  // Producers on every TaskPool thread push while this thread drains, once
+  // through the ring and once through the mutex-guarded std::queue it
+  // replaced. A producer that finds the ring full retries, as pushMessage
+  // would fall back to its overflow queue.
+  size_t const nbProducers = std::max<size_t>(TaskPool::instance().size(), 1);
+  size_t const perProducer =
+      (std::max(nbMessages, 1) + nbProducers - 1) / nbProducers;
+  size_t const total = perProducer * nbProducers;
+  Staircase::Message const sample =
+      chain(MessageType::ClearScreen, MessageType::ClearScreen,
+            MessageType::InitStepFile, MessageType::NextFrame);
+  size_t checksum = 0;
+
+  auto ring = std::make_unique<
+      MessageRing<Staircase::Message, MESSAGE_RING_CAPACITY>>();
+  std::atomic<size_t> ringFullRetries{0};
+  std::vector<std::future<void>> producers;
+  double start = emscripten_get_now();
+  for (size_t p = 0; p < nbProducers; ++p) {
+    producers.push_back(TaskPool::instance().submit([&] {
+      for (size_t i = 0; i < perProducer; ++i) {
+        while (!ring->tryPush(sample)) {
+          ringFullRetries++;
+          std::this_thread::yield();
+        }
+      }
+    }));
+  }
+  for (size_t received = 0; received < total;) {
+    Staircase::Message message;
+    if (ring->tryPop(message)) {
+      checksum += message.nbFollowing;
+      ++received;
+    }
+  }
+  double const ringMs = emscripten_get_now() - start;
+  for (auto &producer : producers) { producer.get(); }
+  producers.clear();
+
+  std::mutex mutex;
+  std::queue<Staircase::Message> queue;
+  start = emscripten_get_now();
+  for (size_t p = 0; p < nbProducers; ++p) {
+    producers.push_back(TaskPool::instance().submit([&] {
+      for (size_t i = 0; i < perProducer; ++i) {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push(sample);
+      }
+    }));
+  }
+  for (size_t received = 0; received < total;) {
+    std::queue<Staircase::Message> local;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::swap(local, queue);
+    }
+    for (; !local.empty(); local.pop()) {
+      checksum += local.front().nbFollowing;
+      ++received;
+    }
+  }
+  double const queueMs = emscripten_get_now() - start;
+  for (auto &producer : producers) { producer.get(); }
+
+  emscripten::val result = emscripten::val::object();
+  result.set("messages", total);
+  result.set("producers", nbProducers);
+  result.set("ringMs", ringMs);
+  result.set("ringFullRetries", ringFullRetries.load());
+  result.set("mutexQueueMs", queueMs);
+  result.set("ringMessagesPerSecond", total / std::max(ringMs, 1e-3) * 1000.0);
+  result.set("mutexQueueMessagesPerSecond",
+             total / std::max(queueMs, 1e-3) * 1000.0);
+  result.set("checksum", checksum);
+  return result;
+}
+
+void StaircaseViewer::setOcclusionCulling(bool value) {
+  context->viewController->setOcclusionCulling(value);
+}
+
+void StaircaseViewer::setMeshOnlyMode(bool value) {
+  context->meshOnlyMode = value;
+}
 
 void *StaircaseViewer::backgroundWorker(void *) {
   while (true) {
     Staircase::Message msg = StaircaseViewer::popBackground();
-    StaircaseViewer::_loadStepFile(msg.data);
+    StaircaseViewer::_loadStepFile(
+        std::get<Staircase::LoadStepFilePayload>(msg.payload).viewer);
   }
   return nullptr;
 }
@@ -304,24 +581,27 @@ Staircase::Message StaircaseViewer::popBackground() {
 }
 
 void StaircaseViewer::handleMessages(void *arg) {
-  if (isHandlingMessages.exchange(true)) {
-    return;
-  }
-
   auto context = static_cast<ViewerContext *>(arg);
-  auto localQueue = context->drainMessageQueue();
-  bool nextFrame = false;
-  int const FPS60 = 1000 / 60;
-
-  auto schedNextFrameWith = [&context, &nextFrame](MessageType::Type type) {
-    Staircase::Message msg(type);
-    context->pushMessage(msg);
-    nextFrame = true;
+  auto const deadline = context->getTurnDeadline();
+
+  // Messages pushed from here are handled on the next frame.
+  auto schedNextFrameWith = [&context](MessageType::Type type) {
+    context->pushMessage({type});
   };
 
-  while (!localQueue.empty()) {
-    Staircase::Message message = localQueue.front();
-    localQueue.pop();
+  // Interactive messages are always handled. Overlays and the scene build
+  // only get the turn's time that is left, with at least one message per
+  // turn so none of them starves.
+  context->beginMessageRound();
+  Staircase::Message message;
+  bool isFirst = true;
+  while (true) {
+    bool const hasTime =
+        isFirst || MessageScheduler::Clock::now() < deadline;
+    MessageType::Lane const lowest =
+        hasTime ? MessageType::Bulk : MessageType::Interactive;
+    if (!context->popMessage(message, lowest)) { break; }
+    isFirst = false;
 
     switch (message.type) {
     case MessageType::ClearScreen: clearCanvas(Colors::Platinum); break;
@@ -331,15 +611,36 @@ void StaircaseViewer::handleMessages(void *arg) {
       context->viewController->updateView();
       break;
     case MessageType::InitStepFile:
-      context->viewController->initStepFile(context->currentlyViewingDoc);
+      context->viewController->initStepFile(context->loadedParts,
+                                            context->loadedEdges,
+                                            context->loadedNodes);
+      [[fallthrough]];
+    case MessageType::ContinueStepFile:
+      // Yield to the browser between slices of the scene build.
+      if (!context->viewController->continueStepFile(deadline)) {
+        schedNextFrameWith(MessageType::ContinueStepFile);
+      } else {
+        schedNextFrameWith(MessageType::ActivateSelection);
+      }
       break;
-    case MessageType::NextFrame: {
-
-      if (context->isMessageQueueEmpty()) {
-        schedNextFrameWith(MessageType::NextFrame);
-      } // else { /* Next frame inevitable. */ }
+    case MessageType::HoverResult:
+      context->viewController->applyHoverResult();
+      break;
+    case MessageType::DrawingViewResult:
+      context->viewController->applyDrawingViewResult();
+      break;
+    case MessageType::SelectionPrebuilt:
+      context->viewController->applyPrebuiltSelections();
+      break;
+    case MessageType::ActivateSelection:
+      // Sensitive entities of parts not picked yet, built while idle.
+      if (!context->viewController->continueSelectionActivation(deadline)) {
+        schedNextFrameWith(MessageType::ActivateSelection);
+      }
+      break;
+    case MessageType::NextFrame:
+      // Only ends chains; nothing waits for it.
       break;
-    }
     case MessageType::DrawLoadingScreen: {
       clearCanvas(Colors::Platinum);
       if (context->viewController->shouldRender) {
@@ -355,7 +656,6 @@ void StaircaseViewer::handleMessages(void *arg) {
         cleanupShaders(context->shaderProgram,
                        {context->vertexShader, context->fragmentShader});
         context->viewController->shouldRender = true;
-        nextFrame = false;
       }
       break;
     }
@@ -363,20 +663,32 @@ void StaircaseViewer::handleMessages(void *arg) {
     default: std::cout << "Unhandled MessageType::" << std::endl; break;
     }
 
-    if (message.nextMessage) {
-      context->pushMessage(*message.nextMessage);
-      nextFrame = true;
-    }
+    // The rest of a chain follows one frame at a time.
+    if (message.hasNext()) { context->pushMessage(message.next()); }
   }
 
-  isHandlingMessages = false;
-  if (nextFrame) { emscripten_set_timeout(handleMessages, FPS60, context); }
+  // The rest of the round waits for this viewer's next turn.
+  if (context->hasRoundMessages()) { context->requestTurn(); }
 }
 
 extern "C" void dummyMainLoop() { emscripten_cancel_main_loop(); }
 void dummyDeleter(StaircaseViewer *) {}
 
 EMSCRIPTEN_BINDINGS(staircase) {
+  emscripten::enum_<DisplayStyle>("DisplayStyle")
+      .value("Shaded", DisplayStyle::Shaded)
+      .value("Wireframe", DisplayStyle::Wireframe)
+      .value("ShadedWithEdges", DisplayStyle::ShadedWithEdges);
+
+  emscripten::enum_<DrawingView>("DrawingView")
+      .value("Front", DrawingView::Front)
+      .value("Back", DrawingView::Back)
+      .value("Top", DrawingView::Top)
+      .value("Bottom", DrawingView::Bottom)
+      .value("Left", DrawingView::Left)
+      .value("Right", DrawingView::Right)
+      .value("Iso", DrawingView::Iso);
+
   emscripten::class_<StaircaseViewer>("StaircaseViewer")
       .constructor<std::string const &>()
       .function("displaySplashScreen", &StaircaseViewer::displaySplashScreen)
@@ -385,6 +697,32 @@ EMSCRIPTEN_BINDINGS(staircase) {
       .function("getOCCTVersion", &StaircaseViewer::getOCCTVersion)
       .function("fitAllObjects", &StaircaseViewer::fitAllObjects)
       .function("removeAllObjects", &StaircaseViewer::removeAllObjects)
+      .function("setCompactVertexFormat", &StaircaseViewer::setCompactVertexFormat)
+      .function("setLargeModelMode", &StaircaseViewer::setLargeModelMode)
+      .function("setMeshOnlyMode", &StaircaseViewer::setMeshOnlyMode)
+      .function("setDisplayStyle", &StaircaseViewer::setDisplayStyle)
+      .function("setSceneBuildBudget", &StaircaseViewer::setSceneBuildBudget)
+      .function("getSceneBuildStats", &StaircaseViewer::getSceneBuildStats)
+      .function("setCullingSize", &StaircaseViewer::setCullingSize)
+      .function("getCullingStats", &StaircaseViewer::getCullingStats)
+      .function("setOcclusionCulling", &StaircaseViewer::setOcclusionCulling)
+      .function("getSelectionStats", &StaircaseViewer::getSelectionStats)
+      .function("getFrameStats", &StaircaseViewer::getFrameStats)
+      .function("benchmarkMessageQueue", &StaircaseViewer::benchmarkMessageQueue)
+      .function("benchmarkPicking", &StaircaseViewer::benchmarkPicking)
+      .function("setOffThreadHover", &StaircaseViewer::setOffThreadHover)
+      .function("setSuspended", &StaircaseViewer::setSuspended)
+      .function("setVisible", &StaircaseViewer::setVisible)
+      .function("setNodesVisible", &StaircaseViewer::setNodesVisible)
+      .function("setAllVisible", &StaircaseViewer::setAllVisible)
+      .function("isVisible", &StaircaseViewer::isVisible)
+      .function("getNodeIds", &StaircaseViewer::getNodeIds)
+      .function("showDrawingView", &StaircaseViewer::showDrawingView)
+      .function("hideDrawingView", &StaircaseViewer::hideDrawingView)
+      .function("addSectionPlane", &StaircaseViewer::addSectionPlane)
+      .function("setSectionPlane", &StaircaseViewer::setSectionPlane)
+      .function("removeSectionPlane", &StaircaseViewer::removeSectionPlane)
+      .function("removeAllSectionPlanes", &StaircaseViewer::removeAllSectionPlanes)
       .function("loadStepFile", &StaircaseViewer::loadStepFile)
       .function("getContainerId", &StaircaseViewer::getContainerId)
       .class_function("deleteViewer", &StaircaseViewer::deleteViewer, emscripten::allow_raw_pointers());
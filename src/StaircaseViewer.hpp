@@ -46,6 +46,38 @@ public:
   std::string getStepFileContent();
   void fitAllObjects ();
   void removeAllObjects();
+  // Trades lighting fidelity for memory; see
+  // StaircaseViewController::setCompactVertexFormat.
+  void setCompactVertexFormat(bool value);
+  void setLargeModelMode(bool value);
+  void setMeshOnlyMode(bool value);
+  void setDisplayStyle(DisplayStyle style);
+  void setSceneBuildBudget(double milliseconds);
+  emscripten::val getSceneBuildStats();
+  void setCullingSize(int pixels);
+  emscripten::val getCullingStats();
+  void setOcclusionCulling(bool value);
+  emscripten::val getSelectionStats();
+  // Timings of the frame pump shared by all viewers.
+  emscripten::val getFrameStats();
+  emscripten::val benchmarkMessageQueue(int nbMessages);
+  emscripten::val benchmarkPicking(int nbPicks);
+  void setOffThreadHover(bool value);
+  // Parks the message loop and redraws of a viewer that cannot be seen.
+  void setSuspended(bool value);
+  size_t setVisible(std::string const &nodeId, bool visible);
+  size_t setNodesVisible(emscripten::val const &nodeIds, bool visible);
+  size_t setAllVisible(bool visible);
+  bool isVisible(std::string const &nodeId);
+  emscripten::val getNodeIds();
+  bool showDrawingView(DrawingView direction);
+  void hideDrawingView();
+  int addSectionPlane(double x, double y, double z, double nx, double ny,
+                      double nz);
+  bool setSectionPlane(int planeId, double x, double y, double z, double nx,
+                       double ny, double nz);
+  bool removeSectionPlane(int planeId);
+  void removeAllSectionPlanes();
 
 private:
   std::string _stepFileContent;
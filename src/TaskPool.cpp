@@ -0,0 +1,92 @@
+#include "TaskPool.hpp"
+
+namespace {
+// Index of the pool worker running on this thread, or -1 elsewhere.
+thread_local int workerIndex = -1;
+} // namespace
+
+TaskPool &TaskPool::instance() {
+  static TaskPool pool(TASK_POOL_THREADS);
+  return pool;
+}
+
+TaskPool::TaskPool(size_t nbThreads) {
+  for (size_t i = 0; i < nbThreads; ++i) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < nbThreads; ++i) {
+    threads.emplace_back(&TaskPool::run, this, i);
+  }
+}
+
+TaskPool::~TaskPool() {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    toStop = true;
+  }
+  wakeCv.notify_all();
+  for (auto &thread : threads) { thread.join(); }
+}
+
+void TaskPool::push(Task task, bool isUrgent) {
+  if (isUrgent) {
+    std::lock_guard<std::mutex> lock(urgent.mutex);
+    urgent.tasks.push_back(std::move(task));
+  } else {
+    size_t const index =
+        workerIndex >= 0 ? size_t(workerIndex) : nextQueue++ % queues.size();
+    std::lock_guard<std::mutex> lock(queues[index]->mutex);
+    queues[index]->tasks.push_back(std::move(task));
+  }
+  {
+    // Counted under the lock, so a worker about to sleep sees it.
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    nbQueued++;
+  }
+  wakeCv.notify_one();
+}
+
+bool TaskPool::take(size_t self, Task &task) {
+  {
+    std::lock_guard<std::mutex> lock(urgent.mutex);
+    if (!urgent.tasks.empty()) {
+      task = std::move(urgent.tasks.front());
+      urgent.tasks.pop_front();
+      return true;
+    }
+  }
+  {
+    Queue &own = *queues[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); ++i) {
+    Queue &victim = *queues[(self + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskPool::run(size_t index) {
+  workerIndex = static_cast<int>(index);
+  while (true) {
+    Task task;
+    if (take(index, task)) {
+      nbQueued--;
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCv.wait(lock, [this] { return toStop || nbQueued > 0; });
+    if (toStop) { return; }
+  }
+}
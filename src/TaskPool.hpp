@@ -0,0 +1,77 @@
+#ifndef TASKPOOL_HPP
+#define TASKPOOL_HPP
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef TASK_POOL_THREADS
+#define TASK_POOL_THREADS 2
+#endif
+
+/**
+ * Work-stealing pool for background jobs such as meshing.
+ *
+ * Every worker thread has its own deque. Tasks submitted from a worker go to
+ * the back of its deque and it takes them from there, newest first, while
+ * its cache is still warm. Tasks from other threads are dealt out round
+ * robin. A worker whose deque is empty steals the oldest task of another
+ * one. Urgent tasks, such as answers to the cursor, go to a shared queue
+ * every worker empties before it looks at the deques. The threads start with
+ * the first use and come from the Emscripten pthread pool.
+ *
+ * Waiting on a future from inside a task can deadlock once every worker
+ * waits; tasks should not block on each other.
+ */
+class TaskPool {
+public:
+  static TaskPool &instance();
+  ~TaskPool();
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F &&function,
+                                              bool isUrgent = false) {
+    typedef std::invoke_result_t<F> Result;
+    // std::function needs a copyable target, packaged_task is move only.
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<F>(function));
+    std::future<Result> future = task->get_future();
+    push([task]() { (*task)(); }, isUrgent);
+    return future;
+  }
+
+  size_t size() const { return threads.size(); }
+
+private:
+  typedef std::function<void()> Task;
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::atomic<size_t> nextQueue{0};
+  Queue urgent;
+
+  // Tasks in all queues; workers sleep while it is zero.
+  std::atomic<size_t> nbQueued{0};
+  std::mutex wakeMutex;
+  std::condition_variable wakeCv;
+  bool toStop = false;
+
+  // Last, so everything the threads use exists before they start.
+  std::vector<std::thread> threads;
+
+  explicit TaskPool(size_t nbThreads);
+  void push(Task task, bool isUrgent);
+  bool take(size_t self, Task &task);
+  void run(size_t index);
+};
+#endif // TASKPOOL_HPP
@@ -1,34 +1,121 @@
 #ifndef VIEWERCONTEXT_HPP
 #define VIEWERCONTEXT_HPP
+#include "MessageRing.hpp"
+#include "MessageScheduler.hpp"
 #include "staircase.hpp"
 #include <AIS_InteractiveContext.hxx>
 #include <GLES2/gl2.h>
 #include <V3d_View.hxx>
 #include <any>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <emscripten/threading.h>
 #include <mutex>
 #include <opencascade/TDocStd_Document.hxx>
 #include <opencascade/XCAFApp_Application.hxx>
 #include <queue>
+#include <vector>
+
+// Messages a viewer can have waiting before pushes fall back to a locked
+// overflow queue.
+size_t const MESSAGE_RING_CAPACITY = 256;
 
 class ViewerContext {
 public:
+  ViewerContext() { MessageScheduler::instance().add(this, onTurn); }
+  ~ViewerContext() {
+    MessageScheduler::instance().remove(this);
+    // Its workers push into the message ring until they are detached.
+    viewController.reset();
+  }
 
+  // Runs on the main thread, in the viewer's turn on the frame after
+  // messages arrive. Nothing polls the queue, so an idle viewer costs no CPU
+  // at all.
+  void setMessageHandler(void (*handler)(void *)) { messageHandler = handler; }
+
+  // When the handler's current turn should end. It takes at least one
+  // message regardless.
+  MessageScheduler::Clock::time_point getTurnDeadline() const {
+    return turnDeadline;
+  }
 
+  // Parks message handling, e.g. while the viewer is off screen. Messages
+  // keep arriving and are handled once it resumes.
+  void setSuspended(bool suspended) {
+    MessageScheduler::instance().setSuspended(this, suspended);
+  }
+
+  // Asks for another turn, for messages the handler left for later.
+  void requestTurn() {
+    if (!wakeArmed.exchange(true)) {
+      if (emscripten_is_main_runtime_thread()) {
+        MessageScheduler::instance().wake(this);
+      } else {
+        emscripten_async_run_in_main_runtime_thread(EM_FUNC_SIG_VI, onWake,
+                                                    this);
+      }
+    }
+  }
+
+  // Queues a message for the handler's next run. Callable from any thread
+  // without taking a lock, unless the ring is full; workers proxy the
+  // wake-up to the main thread. The handler gets one turn per frame, so
+  // messages it pushes itself wait for the next frame.
   void pushMessage(Staircase::Message const &msg) {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    messageQueue.push(msg);
+    if (overflowing.load(std::memory_order_acquire) ||
+        !messageRing.tryPush(msg)) {
+      // Keeps later messages behind the ones that did not fit.
+      std::lock_guard<std::mutex> lock(overflowMutex);
+      overflowing = true;
+      overflowQueue.push_back(msg);
+    }
+    requestTurn();
+  }
+
+  // Main thread only. Starts a round of popMessage by sorting the messages
+  // that arrived into their lanes; messages pushed after this wait for the
+  // next round. Messages a round left over stay ahead of them.
+  void beginMessageRound() {
+    size_t const roundEnd = messageRing.pushedCount();
+    Staircase::Message msg;
+    while (messageRing.poppedCount() < roundEnd && messageRing.tryPop(msg)) {
+      lanes[MessageType::laneOf(msg.type)].push_back(msg);
+    }
+    std::lock_guard<std::mutex> lock(overflowMutex);
+    if (overflowQueue.empty()) { return; }
+    // Anything still in the ring was pushed before the ring filled up, so
+    // before every overflow message; it goes first, whatever the snapshot.
+    while (messageRing.tryPop(msg)) {
+      lanes[MessageType::laneOf(msg.type)].push_back(msg);
+    }
+    for (Staircase::Message const &overflowMsg : overflowQueue) {
+      lanes[MessageType::laneOf(overflowMsg.type)].push_back(overflowMsg);
+    }
+    overflowQueue.clear();
+    overflowing = false;
   }
 
-  std::queue<Staircase::Message> drainMessageQueue() {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    std::queue<Staircase::Message> localQueue;
-    std::swap(localQueue, messageQueue);
-    return localQueue;
+  // Takes the oldest message of the most urgent lane, looking no further
+  // than `lowest`.
+  bool popMessage(Staircase::Message &msg,
+                  MessageType::Lane lowest = MessageType::Bulk) {
+    for (int lane = MessageType::Interactive; lane <= lowest; ++lane) {
+      if (lanes[lane].empty()) { continue; }
+      msg = lanes[lane].front();
+      lanes[lane].pop_front();
+      return true;
+    }
+    return false;
   }
 
-  bool isMessageQueueEmpty() {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    return messageQueue.empty();
+  // Whether messages of this round are still waiting.
+  bool hasRoundMessages() const {
+    for (auto const &lane : lanes) {
+      if (!lane.empty()) { return true; }
+    }
+    return false;
   }
 
   void pushBackground(const Staircase::Message& msg) {
@@ -46,6 +133,13 @@ public:
   }
 
   Handle(TDocStd_Document) currentlyViewingDoc;
+  std::vector<StaircasePart> loadedParts;
+  StaircaseNodeParts loadedNodes;
+  Handle(Graphic3d_ArrayOfSegments) loadedEdges;
+
+  // When set, the next load keeps only the prepared meshes and releases the
+  // document and its BRep.
+  std::atomic<bool> meshOnlyMode{false};
 
   bool showingSpinner = false;
   GLuint shaderProgram;
@@ -98,8 +192,30 @@ public:
   EMSCRIPTEN_WEBGL_CONTEXT_HANDLE webGLContext;
 private:
   Handle(V3d_View) view;
-  std::queue<Staircase::Message> messageQueue;
-  std::mutex queueMutex;
+  MessageRing<Staircase::Message, MESSAGE_RING_CAPACITY> messageRing;
+  // Messages taken out of the ring, main thread only.
+  std::array<std::deque<Staircase::Message>, MessageType::NB_LANES> lanes;
+
+  // Only used while the ring is full; the vector keeps its capacity.
+  std::atomic<bool> overflowing{false};
+  std::mutex overflowMutex;
+  std::vector<Staircase::Message> overflowQueue;
+
+  void (*messageHandler)(void *) = nullptr;
+  std::atomic<bool> wakeArmed{false};
+
+  MessageScheduler::Clock::time_point turnDeadline;
+
+  static void onWake(void *arg) { MessageScheduler::instance().wake(arg); }
+
+  // Disarmed before the handler runs, so messages pushed while it runs arm
+  // the next wake-up.
+  static void onTurn(void *arg, MessageScheduler::Clock::time_point deadline) {
+    auto context = static_cast<ViewerContext *>(arg);
+    context->wakeArmed = false;
+    context->turnDeadline = deadline;
+    if (context->messageHandler) { context->messageHandler(arg); }
+  }
 
   std::queue<Staircase::Message> backgroundQueue;
   std::mutex backgroundQueueMutex;
@@ -2,7 +2,11 @@
 #define STAIRCASE_HPP
 #include "StaircaseViewController.hpp"
 #include <any>
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <malloc.h>
+#include <variant>
 
 #ifdef DEBUG_BUILD
 #include <chrono>
@@ -19,6 +23,11 @@ enum Type {
   ReadStepFile,
   InitEmptyScene,
   InitStepFile,
+  ContinueStepFile,
+  ActivateSelection,
+  SelectionPrebuilt,
+  HoverResult,
+  DrawingViewResult,
   NextFrame,
   LoadStepFile,
 };
@@ -31,26 +40,85 @@ static char const *toString(Type type) {
   case DrawLoadingScreen: return "DrawLoadingScreen";
   case ReadStepFile: return "ReadStepFile";
   case InitEmptyScene: return "InitEmptyScene";
+  case InitStepFile: return "InitStepFile";
+  case ContinueStepFile: return "ContinueStepFile";
+  case ActivateSelection: return "ActivateSelection";
+  case SelectionPrebuilt: return "SelectionPrebuilt";
+  case HoverResult: return "HoverResult";
+  case DrawingViewResult: return "DrawingViewResult";
   case NextFrame: return "NextFrame";
   case LoadStepFile: return "LoadStepFile";
   default: return "Unknown";
   }
 }
+
+// Priority classes of the message handler, most urgent first. Within a lane
+// messages keep their order.
+enum Lane {
+  Interactive, // answers to user input, e.g. picking
+  Overlay,     // spinners and drawings shown over the scene
+  Bulk,        // building and preparing the scene
+  NB_LANES
+};
+
+static Lane laneOf(Type type) {
+  switch (type) {
+  case HoverResult: return Interactive;
+  case ClearScreen:
+  case DrawCheckerboard:
+  case DrawLoadingScreen:
+  case DrawingViewResult: return Overlay;
+  default: return Bulk;
+  }
+}
 } // namespace MessageType
 
+class StaircaseViewer;
+
 namespace Staircase {
+struct NoPayload {};
+struct LoadStepFilePayload {
+  StaircaseViewer *viewer;
+};
+typedef std::variant<NoPayload, LoadStepFilePayload> Payload;
+
+// Longest chain of messages one Message can carry, itself included.
+size_t const MAX_CHAIN_LENGTH = 8;
+
+/**
+ * A message with a typed payload. The messages that follow it, handled one
+ * frame apart, are stored inline, so copying a message into a queue never
+ * allocates.
+ */
 struct Message {
   MessageType::Type type;
-  void *data;
-  std::shared_ptr<Message> nextMessage;
+  Payload payload;
+  std::array<MessageType::Type, MAX_CHAIN_LENGTH - 1> following{};
+  uint8_t nbFollowing = 0;
+
+  Message(MessageType::Type type = MessageType::NextFrame,
+          Payload payload = NoPayload())
+      : type(type), payload(payload) {}
+
+  bool hasNext() const { return nbFollowing > 0; }
 
-  Message(MessageType::Type type, void *data = nullptr)
-      : type(type), data(data), nextMessage(nullptr) {}
+  // The rest of the chain, starting with the next message.
+  Message next() const {
+    Message message(following[0]);
+    for (uint8_t i = 1; i < nbFollowing; ++i) {
+      message.following[i - 1] = following[i];
+    }
+    message.nbFollowing = nbFollowing - 1;
+    return message;
+  }
 };
 } // namespace Staircase
 
 int const AIS_WIREFRAME_MODE = 0;
 int const AIS_SHADED_MODE = 1;
+// First display mode of the StaircaseShape navigation proxies. AIS_Shape
+// already uses 2 for its bounding box presentation.
+int const AIS_LOD_MODE = 3;
 
 struct RGB {
   float r, g, b;
@@ -73,6 +141,9 @@ private:
   std::string name;
   std::chrono::time_point<std::chrono::high_resolution_clock> start;
 };
+// Bytes of heap currently handed out by malloc.
+inline size_t heapBytesInUse() { return mallinfo().uordblks; }
+
 namespace Colors {
 // clang-format off
 const RGB Red      = {1.0f, 0.0f, 0.0f};
@@ -105,20 +176,11 @@ enum class RenderingMode {
 
 
 template <typename... MessageTypes>
-std::shared_ptr<Staircase::Message> chain(MessageTypes... types) {
-  std::shared_ptr<Staircase::Message> head = nullptr;
-  std::shared_ptr<Staircase::Message> current = nullptr;
-
-  auto createAndLink = [&head, &current](MessageType::Type type) {
-    auto newMsg = std::make_shared<Staircase::Message>(type);
-    if (!head) {
-      head = newMsg;
-    } else {
-      current->nextMessage = newMsg;
-    }
-    current = newMsg;
-  };
-  (createAndLink(types), ...);
+Staircase::Message chain(MessageType::Type first, MessageTypes... rest) {
+  static_assert(sizeof...(rest) < Staircase::MAX_CHAIN_LENGTH,
+                "chain longer than MAX_CHAIN_LENGTH");
+  Staircase::Message head(first);
+  ((head.following[head.nbFollowing++] = rest), ...);
   return head;
 }
 
@@ -21,11 +21,43 @@ if (typeof document !== "undefined") { // To avoid this code block in worker thr
         window.Staircase._viewers = window.Staircase._viewers || new Map();
         window.Staircase._observers = window.Staircase._observers || new Map();
         window.Staircase._containerIds = window.Staircase._containerIds || new Set();
+        window.Staircase._onScreen = window.Staircase._onScreen || new Set();
+
+        // Viewers scrolled out of view or in a hidden tab park their message
+        // loop and redraws, and draw once when they can be seen again.
+        let updateSuspended = function(containerId) {
+            let viewer = window.Staircase._viewers.get(containerId);
+            if (viewer) {
+                viewer.setSuspended(document.hidden ||
+                                    !window.Staircase._onScreen.has(containerId));
+            }
+        };
+
+        let intersectionObserver = new IntersectionObserver(entries => {
+            for (let entry of entries) {
+                let containerId = entry.target.id;
+                if (entry.isIntersecting) {
+                    window.Staircase._onScreen.add(containerId);
+                } else {
+                    window.Staircase._onScreen.delete(containerId);
+                }
+                updateSuspended(containerId);
+            }
+        });
+
+        let onVisibilityChange = function() {
+            for (let containerId of window.Staircase._viewers.keys()) {
+                updateSuspended(containerId);
+            }
+        };
+        document.addEventListener("visibilitychange", onVisibilityChange);
 
         let ensureViewerCreated = function(containerId) {
             if (!window.Staircase._viewers.has(containerId)) {
                 let viewer = new module.StaircaseViewer(containerId);
                 window.Staircase._viewers.set(containerId, viewer);
+                // Reports the current intersection right away.
+                intersectionObserver.observe(document.getElementById(containerId));
                 return viewer;
             }
             return window.Staircase._viewers.get(containerId);
@@ -114,6 +146,9 @@ if (typeof document !== "undefined") { // To avoid this code block in worker thr
             window.Staircase._viewers.clear();
             window.Staircase._observers.forEach(x => x.disconnect());
             window.Staircase._observers.clear();
+            intersectionObserver.disconnect();
+            window.Staircase._onScreen.clear();
+            document.removeEventListener("visibilitychange", onVisibilityChange);
 
             window.Staircase.initialized = false;
             window.Staircase = null;